@@ -1,9 +1,13 @@
 #include "Arduino.h"
 #include "HomeSpan.h"
 #include "liteRadar.h"
+#include "radarProfile.h"
+#include "radarCalibration.h"
+#include "radarPublisher.h"
 
 #define CONTROL_PIN			9   			// pin for the ontrol button
 #define STATUS_PIN			10				// pin for the status led
+#define CALIBRATE_MS		0				// ms of empty room to calibrate the thresholds from at start, 0 keeps the fixed ones
 
 
 #include <HardwareSerial.h>
@@ -44,6 +48,7 @@ struct DEV_OccupancySensor : Service::OccupancySensor {                       //
 
 	SpanCharacteristic *occupancy;                                         // reference to the MotionDetected Characteristic
 	Radar radar = Radar(&UART);
+	RadarPublisher publisher;                                               // keeps flapping reports off the network
 
 	DEV_OccupancySensor() : Service::OccupancySensor() {
 	Serial.println("start of radar initialzation");
@@ -52,35 +57,29 @@ struct DEV_OccupancySensor : Service::OccupancySensor {                       //
 	if (!radar.resetRadar()) Serial.println("reset failed");
 	else Serial.println("reset succeeds");
 
-	if(!radar.openCustomMode(MODE_1)) Serial.println("open custom mode failed");
-	else Serial.println("open custom mode succeeds");
-
-	if (!radar.setPresenceThreshold((unsigned int)0x1E)) Serial.println("set presence threshold failed");
-	else Serial.println("set presence threshold succeeds");
-	Serial.printf("current presence threshold = %02X\n", radar.getPresenceThreshold());
-
-	if (!radar.setPresenceRange((unsigned int)0x09)) Serial.println("set presence range failed");
-	else Serial.println("set presence range succeeds");
-	Serial.printf("current presence range = %02X\n", radar.getPresenceRange());
-
-	if (!radar.setStationaryValidTime(10000)) Serial.println("set stationary valid time failed");
-	else Serial.println("set stationary valid time succeeds");
-	Serial.printf("current stationary valid time = %d\n", radar.getStationaryValidTime());
-
-	if (!radar.setMotionThreshold(0x0E)) Serial.println("set presence threshold failed");
-	else Serial.println("set motion threshold succeeds");
-	Serial.printf("current motion threshold = %02X\n", radar.getMotionThreshold());
-
-	if (!radar.setMotionRange(0x09)) Serial.println("set motion range failed");
-	else Serial.println("set motion range succeeds");
-	Serial.printf("current motion range = %02X\n", radar.getMotionRange());
-
-	if (!radar.setMotionValidTime(3000)) Serial.println("set motion valid time failed");
-	else Serial.println("set motion valid time succeeds");
-	Serial.printf("current motion valid time = %d\n", radar.getMotionValidTime());
-
-	if(!radar.exitCustomMode()) Serial.println("exit custom mode failed");
-	else Serial.println("exit custom mode succeeds");
+	// all of the custom mode settings go out in one pipelined transaction
+	RadarProfile profile(MODE_1);
+	profile.setPresenceThreshold(0x1E);
+	profile.setPresenceRange(0x09);
+	profile.setStationaryValidTime(10000);
+	profile.setMotionThreshold(0x0E);
+	profile.setMotionRange(0x09);
+	profile.setMotionValidTime(3000);
+
+	RadarCalibration calibration;						// replaces the thresholds and ranges above
+	calibration.setRange(0x09, 0x09);
+	if (CALIBRATE_MS > 0 && calibration.calibrate(&radar, CALIBRATE_MS)) {
+		Serial.printf("calibrated presence threshold = %d range = %d, motion threshold = %d range = %d\n",
+			calibration.presenceThreshold(), calibration.presenceRange(), calibration.motionThreshold(), calibration.motionRange());
+		calibration.suggest(&profile);
+	}
+
+	if (profile.apply(&radar)) Serial.println("custom mode profile succeeds");
+	else {
+		ProfileResult result = profile.result();
+		Serial.printf("custom mode profile failed: opened = %d exited = %d failed mask = %02X\n",
+			result.opened, result.exited, result.failed);
+	}
 
 	if (!radar.resetRadar()) Serial.println("reset failed");
 	else Serial.println("reset succeeds");
@@ -89,20 +88,27 @@ struct DEV_OccupancySensor : Service::OccupancySensor {                       //
 	// done with radar setup
 
 		occupancy = new Characteristic::OccupancyDetected(false);
+		publisher.setHysteresis(EVENT_PRESENCE, 0, 2000);	// arrivals at once, absence has to hold 2s
+		publisher.onPublish(radarEvent, this);
+		radar.setPublisher(&publisher);				// presence changes are pushed to us from here on
 		
 	}  // end of constructor	
 
-	void loop() {
-		if (radar.updateStatus()) {
-			boolean occupied = radar.isPresent();
-			if (occupied != occupancy->getVal()) {
-				LOG1("occupied = %d\n", occupied);
-				occupancy->setVal(occupied);
-				if (occupied == true) {
-					LOG1("occupancy detected\n");
-				}
+	static void radarEvent(const RadarEvent* event, void* context) {
+		if (event->type != EVENT_PRESENCE) return;
+		DEV_OccupancySensor* sensor = (DEV_OccupancySensor*)context;
+		boolean occupied = event->current;
+		if (occupied != sensor->occupancy->getVal()) {
+			LOG1("occupied = %d at %lu ms\n", occupied, event->t);
+			sensor->occupancy->setVal(occupied);
+			if (occupied == true) {
+				LOG1("occupancy detected\n");
 			}
 		}
+	}
+
+	void loop() {
+		radar.updateStatus();						// published changes are delivered from in here
 	}	// update routine
 };
 
@@ -35,7 +35,20 @@ void setup() {
     sprintf(buff, "underlying status = %02X\n", radar.getUnderlying());
     Serial.print(buff);
 
-    radar.streamFrames(20000);
+    // decode the open data for 20 seconds and print it in batches
+    RadarSample samples[8];
+    unsigned long start = millis();
+    while (millis() - start < 20000) {
+        radar.updateStatus();
+        unsigned int n = radar.readSamples(samples, 8);
+        for (unsigned int i = 0; i < n; i++) {
+            if (samples[i].type != SAMPLE_UNDERLYING) continue;
+            sprintf(buff, "%lu %3d@%d %3d@%d %d\n", samples[i].t,
+                samples[i].presence_energy, samples[i].presence_gate,
+                samples[i].motion_energy, samples[i].motion_gate, samples[i].speed);
+            Serial.print(buff);
+        }
+    }
     Serial.println("\nfinished setup\n");
 
     if (!radar.setUnderlying(0x00)) Serial.println("set underlying failed");
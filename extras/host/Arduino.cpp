@@ -0,0 +1,156 @@
+/*
+ * Host side implementation of the minimal Arduino core. The clock is the real monotonic
+ * clock unless a test or benchmark installs its own, or switches to the manual clock which
+ * only moves when it is advanced or read.
+ *
+ */
+
+#include "Arduino.h"
+#include <atomic>
+#include <sched.h>
+#include <time.h>
+
+HostSerial Serial;
+
+static HostClock host_clock = NULL;
+static bool manual_clock = false;
+static std::atomic<unsigned long> manual_us(0);				// read from the reader thread too
+static unsigned long manual_step = 0;
+
+static unsigned long realMicros() {
+	static struct timespec start = {0, 0};
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (start.tv_sec == 0 && start.tv_nsec == 0) start = now;
+	return (unsigned long)((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000);
+}
+
+/*!
+ * @fn hostSetClock
+ * @brief installs a clock function, NULL goes back to the real clock
+ * @param clock function returning microseconds
+ */
+void hostSetClock(HostClock clock) {
+	host_clock = clock;
+	manual_clock = false;
+}
+
+/*!
+ * @fn hostManualClock
+ * @brief switches to a virtual clock starting at 0. Every read of millis() or micros()
+ * 		moves it on by step_us, so code that spins on millis() still makes progress
+ * @param step_us microseconds added per read, 0 freezes the clock between advances
+ */
+void hostManualClock(unsigned long step_us) {
+	host_clock = NULL;
+	manual_clock = true;
+	manual_us = 0;
+	manual_step = step_us;
+}
+
+/*!
+ * @fn hostAdvanceClock
+ * @brief moves the manual clock forward
+ * @param us microseconds to add
+ */
+void hostAdvanceClock(unsigned long us) {
+	manual_us += us;
+}
+
+unsigned long micros() {
+	if (manual_clock) return manual_us += manual_step;
+	if (host_clock != NULL) return host_clock();
+	return realMicros();
+}
+
+unsigned long millis() {
+	return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+	if (manual_clock) {
+		manual_us += ms * 1000;
+		return;
+	}
+	struct timespec t = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+	nanosleep(&t, NULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+	if (manual_clock) {
+		manual_us += us;
+		return;
+	}
+	struct timespec t = {0, (long)us * 1000L};
+	nanosleep(&t, NULL);
+}
+
+void yield() {
+	sched_yield();
+}
+
+void noInterrupts() {
+}
+
+void interrupts() {
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+	size_t n = 0;
+	while (n < size && write(buffer[n])) n++;
+	return n;
+}
+
+size_t Print::print(const char* s) {
+	return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(char c) {
+	return write((uint8_t)c);
+}
+
+size_t Print::print(int n, int base) {
+	return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+	if (base == DEC) return printf("%ld", n);
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	return printf(base == HEX ? "%lX" : "%lu", n);
+}
+
+size_t Print::print(double n, int digits) {
+	return printf("%.*f", digits, n);
+}
+
+size_t Print::println() {
+	return print("\r\n");
+}
+
+size_t Print::printf(const char* format, ...) {
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (n < 0) return 0;
+	if (n >= (int)sizeof(buffer)) n = sizeof(buffer) - 1;
+	return write((const uint8_t*)buffer, n);
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+	size_t n = 0;
+	while (n < length) {
+		int c = read();
+		if (c < 0) break;
+		buffer[n++] = (char)c;
+	}
+	return n;
+}
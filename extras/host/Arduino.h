@@ -0,0 +1,111 @@
+/*!
+ * @headerfile Arduino.h
+ * @details	minimal Arduino core for building liteRadar on a Linux host. Only what the library,
+ * 			the emulator and the host tools use is provided. millis() and micros() run from an
+ * 			injectable clock so runs against the emulator can be made deterministic
+ */
+
+#ifndef hostArduino_h
+#define hostArduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define pgm_read_byte(p)			(*(const uint8_t*)(p))
+#define memcpy_P					memcpy
+
+#define HEX							16
+#define DEC							10
+
+/*!
+ * @typedef		HostClock
+ * @brief		clock function returning microseconds since start
+ */
+typedef unsigned long (*HostClock)();
+
+void hostSetClock(HostClock clock);
+void hostManualClock(unsigned long step_us);
+void hostAdvanceClock(unsigned long us);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+void noInterrupts();
+void interrupts();
+
+/*!
+ * @class Print
+ * @brief byte sink with the usual print helpers
+ */
+
+class Print {
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t* buffer, size_t size);
+		size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+		virtual int availableForWrite() { return 0; }
+		virtual void flush() {}
+
+		size_t print(const char* s);
+		size_t print(char c);
+		size_t print(int n, int base = DEC);
+		size_t print(unsigned int n, int base = DEC);
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC);
+		size_t print(double n, int digits = 2);
+		size_t println();
+		template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+		template <typename T> size_t println(T v, int base) { size_t n = print(v, base); return n + println(); }
+		size_t printf(const char* format, ...);
+};
+
+/*!
+ * @class Stream
+ * @brief readable byte stream
+ */
+
+class Stream : public Print {
+	protected:
+		unsigned long timeout;
+	public:
+		Stream() : timeout(1000) {}
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+		virtual size_t readBytes(char* buffer, size_t length);
+		size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+		void setTimeout(unsigned long t) { timeout = t; }
+};
+
+/*!
+ * @class HostSerial
+ * @brief Serial on the host, writes go to stdout and nothing is ever read
+ */
+
+class HostSerial : public Stream {
+	public:
+		void begin(unsigned long) {}
+		int available() { return 0; }
+		int read() { return -1; }
+		int peek() { return -1; }
+		size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+		size_t write(const uint8_t* buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+		int availableForWrite() { return 4096; }
+		void flush() { fflush(stdout); }
+		operator bool() { return true; }
+};
+
+extern HostSerial Serial;
+
+#endif
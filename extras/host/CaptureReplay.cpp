@@ -0,0 +1,169 @@
+/*
+ * CaptureReplay decodes a whole capture up front into the received bytes and the capture time
+ * of the end of each chunk. Reading releases every chunk whose time has come, so a Radar sees
+ * the same chunking and gaps it saw in the field.
+ *
+ */
+
+#include "CaptureReplay.h"
+
+CaptureReplay::CaptureReplay()
+	: tx_bytes(0), next_chunk(0), released(0), pos(0), speed(1.0), started(false), start(0) {
+}
+
+/*!
+ * @fn load
+ * @brief decodes a capture held in memory
+ * @returns false if it is not a capture or is cut short. Records before the cut are kept
+ */
+bool CaptureReplay::load(const unsigned char* data, size_t length) {
+	rx.clear();
+	chunks.clear();
+	tx_bytes = 0;
+	rewind();
+	if (length < CAPTURE_HEADER_SIZE || memcmp(data, CAPTURE_MAGIC, 3) || data[3] != CAPTURE_VERSION) return false;
+	size_t i = CAPTURE_HEADER_SIZE;
+	unsigned long long t = 0;
+	while (i < length) {
+		unsigned long long v[2] = {0, 0};
+		for (int field = 0; field < 2; field++) {
+			int shift = 0;
+			while (true) {
+				if (i >= length || shift > 56) return false;
+				byte b = data[i++];
+				v[field] |= (unsigned long long)(b & 0x7F) << shift;
+				shift += 7;
+				if (!(b & 0x80)) break;
+			}
+		}
+		size_t n = v[1] >> 1;
+		if (i + n > length) return false;
+		t += v[0];
+		if (v[1] & 0x01) tx_bytes += n;
+		else {
+			rx.insert(rx.end(), data + i, data + i + n);
+			Chunk c = {t, rx.size()};
+			chunks.push_back(c);
+		}
+		i += n;
+	}
+	return true;
+}
+
+/*!
+ * @fn open
+ * @brief reads and decodes a capture file
+ * @returns false if the file could not be read or is not a capture
+ */
+bool CaptureReplay::open(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return false;
+	std::vector<unsigned char> data;
+	unsigned char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+	fclose(f);
+	return !data.empty() && load(&data[0], data.size());
+}
+
+/*!
+ * @fn setSpeed
+ * @brief sets the replay speed
+ * @param s 1.0 for real time, 10.0 for ten times faster, REPLAY_AS_FAST_AS_POSSIBLE for no waits
+ */
+void CaptureReplay::setSpeed(double s) {
+	speed = s;
+}
+
+/*!
+ * @fn rewind
+ * @brief starts the replay again, its clock starts on the next read
+ */
+void CaptureReplay::rewind() {
+	next_chunk = 0;
+	released = 0;
+	pos = 0;
+	started = false;
+}
+
+/*!
+ * @fn release
+ * @brief makes every chunk whose capture time has come readable
+ */
+void CaptureReplay::release() {
+	if (!started) {
+		started = true;
+		start = micros();
+	}
+	unsigned long long base = chunks.empty() ? 0 : chunks[0].t;
+	double elapsed = (double)(unsigned long)(micros() - start) * speed;
+	while (next_chunk < chunks.size()) {
+		if (speed > 0 && (double)(chunks[next_chunk].t - base) > elapsed) break;
+		released = chunks[next_chunk].end;
+		next_chunk++;
+	}
+}
+
+/*!
+ * @fn finished
+ * @brief returns true once every received byte has been read
+ */
+bool CaptureReplay::finished() {
+	return pos == rx.size();
+}
+
+/*!
+ * @fn received
+ * @brief returns every byte received in the capture
+ */
+const std::vector<unsigned char>& CaptureReplay::received() {
+	return rx;
+}
+
+/*!
+ * @fn sent
+ * @brief returns the number of bytes written to the module in the capture
+ */
+unsigned long CaptureReplay::sent() {
+	return tx_bytes;
+}
+
+/*!
+ * @fn duration
+ * @brief returns the us between the first and last received chunk
+ */
+unsigned long CaptureReplay::duration() {
+	if (chunks.empty()) return 0;
+	return (unsigned long)(chunks.back().t - chunks[0].t);
+}
+
+int CaptureReplay::available() {
+	release();
+	return released - pos;
+}
+
+int CaptureReplay::read() {
+	release();
+	return pos < released ? rx[pos++] : -1;
+}
+
+int CaptureReplay::peek() {
+	release();
+	return pos < released ? rx[pos] : -1;
+}
+
+size_t CaptureReplay::readBytes(char* buffer, size_t n) {
+	release();
+	if (n > released - pos) n = released - pos;
+	if (n > 0) memcpy(buffer, &rx[pos], n);
+	pos += n;
+	return n;
+}
+
+size_t CaptureReplay::write(uint8_t c) {
+	return 1;
+}
+
+size_t CaptureReplay::write(const uint8_t* buffer, size_t size) {
+	return size;
+}
@@ -0,0 +1,58 @@
+/*!
+ * @headerfile CaptureReplay.h
+ * @details	plays a capture written by CaptureWriter back into a Radar on a Linux host. It is a
+ * 			Stream that releases the received chunks at the times they were captured, scaled by
+ * 			a speed factor, or all at once. Bytes written to it are dropped
+ */
+
+#ifndef CaptureReplay_h
+#define CaptureReplay_h
+
+#include "Arduino.h"
+#include "radarCapture.h"
+#include <vector>
+
+#define REPLAY_AS_FAST_AS_POSSIBLE	0.0			// speed that releases every chunk at once
+
+/*!
+ * @class CaptureReplay
+ * @brief replays the received side of a capture
+ */
+
+class CaptureReplay : public Stream {
+	private:
+		struct Chunk {
+			unsigned long long t;
+			size_t end;
+		};
+		std::vector<unsigned char> rx;
+		std::vector<Chunk> chunks;
+		unsigned long tx_bytes;
+		size_t next_chunk;
+		size_t released;
+		size_t pos;
+		double speed;
+		bool started;
+		unsigned long start;
+		void release();
+	public:
+		CaptureReplay();
+		bool load(const unsigned char* data, size_t length);
+		bool open(const char* path);
+		void setSpeed(double s);
+		void rewind();
+		bool finished();
+		const std::vector<unsigned char>& received();
+		unsigned long sent();
+		unsigned long duration();
+
+		int available();
+		int read();
+		int peek();
+		size_t readBytes(char* buffer, size_t n);
+		size_t write(uint8_t c);
+		size_t write(const uint8_t* buffer, size_t size);
+		using Print::write;
+};
+
+#endif
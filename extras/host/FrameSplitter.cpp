@@ -0,0 +1,92 @@
+/*
+ * FrameSplitter finds frames in a large capture buffer without going through a Stream. The
+ * header search compares HEAD1 and HEAD2 against every position of a block at once, HEAD2
+ * being read from the same block shifted by one byte, so only real HEAD1 HEAD2 pairs come
+ * back as candidates.
+ *
+ */
+
+#include "FrameSplitter.h"
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*!
+ * @fn findHeader
+ * @brief finds the next HEAD1 HEAD2 pair
+ * @param buffer capture
+ * @param from position to start looking at
+ * @param length length of the capture
+ * @returns position of HEAD1, length - 1 if the capture ends on a HEAD1, length if there is none
+ */
+size_t findHeader(const unsigned char* buffer, size_t from, size_t length) {
+	size_t i = from;
+#ifdef __SSE2__
+	const __m128i head1 = _mm_set1_epi8((char)HEAD1);
+	const __m128i head2 = _mm_set1_epi8((char)HEAD2);
+	while (i + 17 <= length) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(buffer + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(buffer + i + 1));
+		int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head1), _mm_cmpeq_epi8(b, head2)));
+		if (mask) return i + __builtin_ctz(mask);
+		i += 16;
+	}
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t highs = 0x8080808080808080ULL;
+	while (i + 9 <= length) {
+		uint64_t a, b;
+		memcpy(&a, buffer + i, 8);
+		memcpy(&b, buffer + i + 1, 8);
+		uint64_t x = (a ^ (ones * HEAD1)) | (b ^ (ones * HEAD2));	// zero byte where a pair starts
+		uint64_t mask = (x - ones) & ~x & highs;					// lowest set bit is exact
+		if (mask) return i + (__builtin_ctzll(mask) >> 3);
+		i += 8;
+	}
+#endif
+	for (; i + 1 < length; i++) {
+		if (buffer[i] == HEAD1 && buffer[i + 1] == HEAD2) return i;
+	}
+	if (i < length && buffer[i] == HEAD1) return i;
+	return length;
+}
+
+/*!
+ * @fn splitFrames
+ * @brief finds every valid frame in a capture
+ * @param buffer capture
+ * @param length length of the capture
+ * @param frames valid frames are appended here
+ * @param stats if not NULL, counts are added to it
+ * @param max_data longest data field accepted
+ * @returns number of bytes used. Bytes after that are the start of a frame cut off by the
+ * 		end of the buffer, carry them over to the next buffer of a chunked capture
+ */
+size_t splitFrames(const unsigned char* buffer, size_t length, std::vector<FrameIndex>& frames,
+		SplitStats* stats, unsigned int max_data) {
+	SplitStats local = {0, 0, 0, 0, 0, 0};
+	if (stats == NULL) stats = &local;
+	size_t i = 0;
+	while (true) {
+		size_t h = findHeader(buffer, i, length);
+		stats->skipped += h - i;
+		if (h + 9 > length) return h;
+		unsigned int data_length = ((unsigned int)buffer[h + 4] << 8) | buffer[h + 5];
+		unsigned int total = data_length + 9;
+		if (data_length <= max_data && h + total > length) return h;
+		stats->candidates++;
+		i = h + 1;
+		if (data_length > max_data) stats->bad_lengths++;
+		else if (frameChecksum(buffer + h, total) != buffer[h + total - 3]) stats->bad_checksums++;
+		else if (buffer[h + total - 2] != END1 || buffer[h + total - 1] != END2) stats->bad_trailers++;
+		else {
+			FrameIndex f = {h, total};
+			frames.push_back(f);
+			stats->frames++;
+			i = h + total;
+			continue;
+		}
+		stats->skipped++;									// rescan from the next byte
+	}
+}
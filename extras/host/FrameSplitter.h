@@ -0,0 +1,52 @@
+/*!
+ * @headerfile FrameSplitter.h
+ * @details	offline counterpart of the Radar receive parser for recorded captures on a Linux host.
+ * 			Header candidates are found 16 bytes at a time with SSE2, or 8 bytes at a time with
+ * 			word at a time compares where SSE2 is not available, and each candidate is checked
+ * 			with the length field, frameChecksum and the trailer. A candidate that fails is
+ * 			rescanned from the next byte, the same way the device parser recovers
+ */
+
+#ifndef FrameSplitter_h
+#define FrameSplitter_h
+
+#include "liteRadar.h"
+#include <vector>
+
+#define SPLIT_MAX_DATA				256			// longest data field accepted, longer is a false header
+
+/*!
+ * @struct		FrameIndex
+ * @param		offset		position of HEAD1 in the buffer
+ * @param		length		length of the whole frame, header to trailer
+ */
+
+struct FrameIndex {
+	size_t offset;
+	unsigned int length;
+};
+
+/*!
+ * @struct		SplitStats
+ * @param		candidates	HEAD1 HEAD2 pairs looked at
+ * @param		frames		candidates that were valid frames
+ * @param		bad_lengths	candidates with a data length over the limit
+ * @param		bad_checksums	candidates that failed the checksum
+ * @param		bad_trailers	candidates with a bad END1 END2
+ * @param		skipped		bytes outside of any valid frame
+ */
+
+struct SplitStats {
+	unsigned long candidates;
+	unsigned long frames;
+	unsigned long bad_lengths;
+	unsigned long bad_checksums;
+	unsigned long bad_trailers;
+	unsigned long skipped;
+};
+
+size_t findHeader(const unsigned char* buffer, size_t from, size_t length);
+size_t splitFrames(const unsigned char* buffer, size_t length, std::vector<FrameIndex>& frames,
+	SplitStats* stats = NULL, unsigned int max_data = SPLIT_MAX_DATA);
+
+#endif
@@ -0,0 +1,425 @@
+/*
+ * RadarEmulator plays the part of the radar module for host builds. Everything it sends is
+ * queued with the millis() time it is due, and moved to the readable side of the stream as
+ * the clock passes that time, with any configured faults applied on the way.
+ *
+ */
+
+#include "RadarEmulator.h"
+#include "liteRadar.h"
+
+#define RESET_TIME					50			// ms from a reset reply to init complete
+
+RadarEmulator::RadarEmulator(unsigned long s)
+	: seed(s ? s : 1), noise_rate(0), drop_rate(0), corrupt_rate(0), reply_delay(2), reply_jitter(0),
+	  heartbeat_interval(1000), underlying_interval(100), muted(false), custom_open(false),
+	  presence(0), motion(0), amplitude(0), position(0), request_count(0), bad_request_count(0),
+	  frame_count(0) {
+	unsigned long now = millis();
+	next_heartbeat = now + heartbeat_interval;
+	next_underlying = now + underlying_interval;
+	memset(energies, 0, sizeof(energies));
+	energies[4] = SPEED_STATIONARY;
+	// factory settings, 1 byte unless noted
+	const unsigned char motion_time[] = {0x00, 0x00, 0x0B, 0xB8};		// 3000 ms
+	const unsigned char stationary_time[] = {0x00, 0x00, 0x27, 0x10};	// 10000 ms
+	const unsigned char absence_time[] = {0x00, 0x00, 0x27, 0x10};		// 10000 ms
+	settings[(CUSTOM << 8) | SET_PRESENCE_THRESHOLD] = std::vector<unsigned char>(1, 0x21);
+	settings[(CUSTOM << 8) | SET_PRESENCE_RANGE] = std::vector<unsigned char>(1, 0x0A);
+	settings[(CUSTOM << 8) | SET_MOTION_THRESHOLD] = std::vector<unsigned char>(1, 0x0F);
+	settings[(CUSTOM << 8) | SET_MOTION_RANGE] = std::vector<unsigned char>(1, 0x0A);
+	settings[(CUSTOM << 8) | SET_MOTION_VALID_TIME] = std::vector<unsigned char>(motion_time, motion_time + 4);
+	settings[(CUSTOM << 8) | SET_STATIONARY_VALID_TIME] = std::vector<unsigned char>(stationary_time, stationary_time + 4);
+	settings[(CUSTOM << 8) | SET_ABSENCE_VALID_TIME] = std::vector<unsigned char>(absence_time, absence_time + 4);
+	settings[(WORKING_STATUS << 8) | SET_SCENARIO] = std::vector<unsigned char>(1, LIVING_ROOM);
+	settings[(WORKING_STATUS << 8) | SET_SENSITIVITY] = std::vector<unsigned char>(1, 0x02);
+	settings[(HUMAN_STATUS << 8) | SET_TIME_OF_ABSENCE] = std::vector<unsigned char>(1, 0x01);
+	settings[(UNDERLYING << 8) | SET_UNDERLYING] = std::vector<unsigned char>(1, 0x00);
+	settings[(WORKING_STATUS_RANGE << 8) | SET_MAX_ACTIVE_RANGE] = std::vector<unsigned char>(1, 0x0A);
+	settings[(WORKING_STATUS_RANGE << 8) | SET_MAX_STATIONARY_RANGE] = std::vector<unsigned char>(1, 0x0A);
+}
+
+/*!
+ * @fn random
+ * @brief xorshift generator so fault injection is repeatable for a given seed
+ */
+unsigned long RadarEmulator::random() {
+	uint32_t x = (uint32_t)seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	seed = x;
+	return x;
+}
+
+bool RadarEmulator::chance(double p) {
+	if (p <= 0) return false;
+	return (random() & 0xFFFFFF) < (unsigned long)(p * 0x1000000);
+}
+
+/*!
+ * @fn frame
+ * @brief builds a complete frame
+ */
+std::vector<unsigned char> RadarEmulator::frame(byte control, byte command, const unsigned char* data, unsigned int length) {
+	std::vector<unsigned char> f;
+	f.reserve(length + 9);
+	f.push_back(HEAD1);
+	f.push_back(HEAD2);
+	f.push_back(control);
+	f.push_back(command);
+	f.push_back((length >> 8) & 0xFF);
+	f.push_back(length & 0xFF);
+	f.insert(f.end(), data, data + length);
+	unsigned char checksum = 0;
+	for (size_t i = 0; i < f.size(); i++) checksum += f[i];
+	f.push_back(checksum);
+	f.push_back(END1);
+	f.push_back(END2);
+	return f;
+}
+
+/*!
+ * @fn queue
+ * @brief queues bytes to become readable at a given millis() time, keeping time order
+ */
+void RadarEmulator::queue(unsigned long at, const std::vector<unsigned char>& bytes) {
+	Scheduled s;
+	s.at = at;
+	s.bytes = bytes;
+	std::vector<Scheduled>::iterator it = scheduled.end();
+	while (it != scheduled.begin() && (long)((it - 1)->at - at) > 0) --it;
+	scheduled.insert(it, s);
+}
+
+/*!
+ * @fn service
+ * @brief generates periodic frames and releases everything that is due, applying faults
+ */
+void RadarEmulator::service() {
+	unsigned long now = millis();
+	if (heartbeat_interval > 0 && (long)(now - next_heartbeat) >= 0) {
+		unsigned char data[] = {0x0F};
+		queue(next_heartbeat, frame(SYSTEM, HEARTBEAT, data, 1));
+		next_heartbeat += heartbeat_interval;
+		if ((long)(now - next_heartbeat) >= 0) next_heartbeat = now + heartbeat_interval;	// fell behind
+	}
+	if (underlying_interval > 0 && (long)(now - next_underlying) >= 0) {
+		if (isUnderlyingOn()) queue(next_underlying, frame(UNDERLYING, UNDERLYING_DATA, energies, 5));
+		next_underlying += underlying_interval;
+		if ((long)(now - next_underlying) >= 0) next_underlying = now + underlying_interval;
+	}
+	size_t due = 0;
+	while (due < scheduled.size() && (long)(now - scheduled[due].at) >= 0) {
+		if (!muted) {
+			const std::vector<unsigned char>& bytes = scheduled[due].bytes;
+			for (size_t i = 0; i < bytes.size(); i++) {
+				if (chance(noise_rate)) ready.push_back(random() & 0xFF);
+				if (chance(drop_rate)) continue;
+				unsigned char b = bytes[i];
+				if (chance(corrupt_rate)) b ^= 1 << (random() & 7);
+				ready.push_back(b);
+			}
+			frame_count++;
+		}
+		due++;
+	}
+	scheduled.erase(scheduled.begin(), scheduled.begin() + due);
+}
+
+/*!
+ * @fn setting
+ * @brief returns the stored data for a setting, or a single zero byte if it was never set
+ */
+std::vector<unsigned char> RadarEmulator::setting(byte control, byte command) {
+	std::map<unsigned int, std::vector<unsigned char> >::iterator it = settings.find((control << 8) | command);
+	if (it == settings.end()) return std::vector<unsigned char>(1, 0x00);
+	return it->second;
+}
+
+/*!
+ * @fn reply
+ * @brief queues a reply after the configured reply delay
+ */
+void RadarEmulator::reply(byte control, byte command, const unsigned char* data, unsigned int length) {
+	unsigned long delay_ms = reply_delay;
+	if (reply_jitter > 0) delay_ms += random() % (reply_jitter + 1);
+	queue(millis() + delay_ms, frame(control, command, data, length));
+}
+
+/*!
+ * @fn handleRequest
+ * @brief answers a complete request frame
+ */
+void RadarEmulator::handleRequest() {
+	unsigned char checksum = 0;
+	size_t cs_byte = request.size() - 3;
+	for (size_t i = 0; i < cs_byte; i++) checksum += request[i];
+	if (checksum != request[cs_byte] || request[cs_byte + 1] != END1 || request[cs_byte + 2] != END2) {
+		bad_request_count++;
+		return;
+	}
+	request_count++;
+	byte control = request[CONTROL];
+	byte command = request[COMMAND];
+	const unsigned char* data = &request[DATA];
+	unsigned int length = request.size() - 9;
+	unsigned char value;
+	if (control == SYSTEM && command == RESET) {
+		reply(control, command, data, length);
+		unsigned char init[] = {0x01};
+		queue(millis() + reply_delay + RESET_TIME, frame(WORKING_STATUS, INIT_COMPLETE, init, 1));
+		custom_open = false;
+		return;
+	}
+	if (control == WORKING_STATUS && (command == OPEN_CUSTOM || command == EXIT_CUSTOM)) {
+		custom_open = (command == OPEN_CUSTOM);
+		reply(control, command, data, length);
+		return;
+	}
+	if (control == HUMAN_STATUS && (command & 0x80) && command != GET_TIME_OF_ABSENCE) {
+		switch (command) {
+			case GET_PRESENCE_EVENT:	value = presence; break;
+			case GET_MOTION_AMP_EVENT:	value = motion; break;
+			case GET_MOTION_AMP_DATA:	value = amplitude; break;
+			case GET_POSITIONB_EVENT:	value = position; break;
+			default:					return;
+		}
+		reply(control, command, &value, 1);
+		return;
+	}
+	if (command & 0x80) {
+		std::vector<unsigned char> v = setting(control, command & 0x7F);
+		reply(control, command, &v[0], v.size());
+		return;
+	}
+	settings[(control << 8) | command] = std::vector<unsigned char>(data, data + length);
+	reply(control, command, data, length);
+}
+
+int RadarEmulator::available() {
+	service();
+	return ready.size();
+}
+
+int RadarEmulator::read() {
+	if (ready.empty()) service();
+	if (ready.empty()) return -1;
+	int c = ready.front();
+	ready.pop_front();
+	return c;
+}
+
+int RadarEmulator::peek() {
+	if (ready.empty()) service();
+	if (ready.empty()) return -1;
+	return ready.front();
+}
+
+size_t RadarEmulator::readBytes(char* buffer, size_t length) {
+	if (ready.size() < length) service();
+	size_t n = 0;
+	while (n < length && !ready.empty()) {
+		buffer[n++] = ready.front();
+		ready.pop_front();
+	}
+	return n;
+}
+
+/*!
+ * @fn write
+ * @brief takes a byte sent by the library. Requests are framed by their length field
+ */
+size_t RadarEmulator::write(uint8_t c) {
+	if (muted) return 1;
+	if (request.empty() && c != HEAD1) return 1;
+	if (request.size() == 1 && c != HEAD2) {
+		request.clear();
+		if (c == HEAD1) request.push_back(c);
+		return 1;
+	}
+	request.push_back(c);
+	if (request.size() >= 6) {
+		size_t length = ((size_t)request[4] << 8) | request[5];
+		if (request.size() == length + 9) {
+			handleRequest();
+			request.clear();
+		}
+	}
+	return 1;
+}
+
+/*!
+ * @fn setHeartbeatInterval
+ * @brief sets how often a heartbeat is sent, 0 turns heartbeats off
+ */
+void RadarEmulator::setHeartbeatInterval(unsigned long ms) {
+	heartbeat_interval = ms;
+	next_heartbeat = millis() + ms;
+}
+
+/*!
+ * @fn setUnderlyingInterval
+ * @brief sets how often underlying data is sent while it is switched on
+ */
+void RadarEmulator::setUnderlyingInterval(unsigned long ms) {
+	underlying_interval = ms;
+	next_underlying = millis() + ms;
+}
+
+/*!
+ * @fn setReplyDelay
+ * @brief sets how long the module takes to answer a request
+ * @param ms fixed delay
+ * @param jitter_ms up to this much is added at random
+ */
+void RadarEmulator::setReplyDelay(unsigned long ms, unsigned long jitter_ms) {
+	reply_delay = ms;
+	reply_jitter = jitter_ms;
+}
+
+/*!
+ * @fn setNoise
+ * @brief sets the per byte fault rates for everything sent from now on
+ * @param noise chance of a random byte being inserted before each byte
+ * @param drop chance of each byte being lost
+ * @param corrupt chance of a bit being flipped in each byte
+ */
+void RadarEmulator::setNoise(double noise, double drop, double corrupt) {
+	noise_rate = noise;
+	drop_rate = drop;
+	corrupt_rate = corrupt;
+}
+
+/*!
+ * @fn setMuted
+ * @brief a muted module ignores requests and sends nothing, like a wedged one
+ */
+void RadarEmulator::setMuted(bool m) {
+	muted = m;
+	if (muted) request.clear();
+}
+
+/*!
+ * @fn setEnergies
+ * @brief sets the values sent in underlying data reports
+ */
+void RadarEmulator::setEnergies(byte presence_energy, byte presence_gate, byte motion_energy, byte motion_gate, byte speed) {
+	energies[0] = presence_energy;
+	energies[1] = presence_gate;
+	energies[2] = motion_energy;
+	energies[3] = motion_gate;
+	energies[4] = speed;
+}
+
+/*!
+ * @fn setPresence
+ * @brief changes the presence state, a report is sent right away if it changed
+ */
+void RadarEmulator::setPresence(byte p) {
+	if (p == presence) return;
+	presence = p;
+	queue(millis(), frame(HUMAN_STATUS, PRESENCE, &presence, 1));
+}
+
+/*!
+ * @fn setMotion
+ * @brief changes the motion state, a report is sent right away if it changed
+ */
+void RadarEmulator::setMotion(byte m) {
+	if (m == motion) return;
+	motion = m;
+	queue(millis(), frame(HUMAN_STATUS, MOTION, &motion, 1));
+}
+
+/*!
+ * @fn setAmplitude
+ * @brief sets the motion amplitude and sends an amplitude report
+ */
+void RadarEmulator::setAmplitude(byte a) {
+	amplitude = a;
+	queue(millis(), frame(HUMAN_STATUS, AMPLITUDE_DATA, &amplitude, 1));
+}
+
+/*!
+ * @fn setPosition
+ * @brief sets the approaching / leaving state and sends a position report
+ */
+void RadarEmulator::setPosition(byte p) {
+	position = p;
+	queue(millis(), frame(HUMAN_STATUS, POSITION_EVENT, &position, 1));
+}
+
+/*!
+ * @fn scheduleFrame
+ * @brief queues an arbitrary frame to be sent at a millis() time
+ */
+void RadarEmulator::scheduleFrame(unsigned long at, byte control, byte command, const unsigned char* data, unsigned int length) {
+	queue(at, frame(control, command, data, length));
+}
+
+/*!
+ * @fn schedulePresence
+ * @brief queues a presence report to be sent at a millis() time
+ */
+void RadarEmulator::schedulePresence(unsigned long at, byte p) {
+	scheduleFrame(at, HUMAN_STATUS, PRESENCE, &p, 1);
+}
+
+/*!
+ * @fn scheduleMotion
+ * @brief queues a motion report to be sent at a millis() time
+ */
+void RadarEmulator::scheduleMotion(unsigned long at, byte m) {
+	scheduleFrame(at, HUMAN_STATUS, MOTION, &m, 1);
+}
+
+/*!
+ * @fn injectBytes
+ * @brief makes raw bytes readable right away, bypassing fault injection
+ */
+void RadarEmulator::injectBytes(const unsigned char* bytes, unsigned int length) {
+	ready.insert(ready.end(), bytes, bytes + length);
+}
+
+bool RadarEmulator::isCustomOpen() {
+	return custom_open;
+}
+
+bool RadarEmulator::isUnderlyingOn() {
+	std::vector<unsigned char> v = setting(UNDERLYING, SET_UNDERLYING);
+	return v[v.size() - 1] != 0;
+}
+
+/*!
+ * @fn getSetting
+ * @brief returns a stored setting as a number
+ * @param control control byte of the setting
+ * @param set_command set command of the setting
+ */
+unsigned long RadarEmulator::getSetting(byte control, byte set_command) {
+	std::vector<unsigned char> v = setting(control, set_command);
+	unsigned long value = 0;
+	for (size_t i = 0; i < v.size(); i++) value = (value << 8) | v[i];
+	return value;
+}
+
+unsigned long RadarEmulator::requests() {
+	return request_count;
+}
+
+unsigned long RadarEmulator::badRequests() {
+	return bad_request_count;
+}
+
+unsigned long RadarEmulator::framesSent() {
+	return frame_count;
+}
+
+/*!
+ * @fn backlog
+ * @brief number of frames queued but not yet due
+ */
+unsigned int RadarEmulator::backlog() {
+	return scheduled.size();
+}
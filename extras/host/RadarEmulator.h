@@ -0,0 +1,98 @@
+/*!
+ * @headerfile RadarEmulator.h
+ * @details	software stand in for the Seeed 24ghz mmWave lite module on a Linux host. It is a
+ * 			Stream, so a Radar can be pointed at it directly. It answers the SYSTEM, WORKING_STATUS,
+ * 			CUSTOM, HUMAN_STATUS and UNDERLYING commands, keeps the settings it is given, sends
+ * 			heartbeats, presence / motion reports and underlying data, and can be scripted to send
+ * 			frames at set times. Noise, dropped bytes, corrupted bytes and reply delays can be
+ * 			injected to exercise the library under bad link conditions
+ */
+
+#ifndef RadarEmulator_h
+#define RadarEmulator_h
+
+#include "Arduino.h"
+#include <deque>
+#include <map>
+#include <vector>
+
+/*!
+ * @class RadarEmulator
+ * @brief emulated module, write commands to it and read its replies and reports
+ */
+
+class RadarEmulator : public Stream {
+	private:
+		struct Scheduled {
+			unsigned long at;
+			std::vector<unsigned char> bytes;
+		};
+		std::vector<Scheduled> scheduled;
+		std::deque<unsigned char> ready;
+		std::vector<unsigned char> request;
+		std::map<unsigned int, std::vector<unsigned char> > settings;
+		unsigned long seed;
+		double noise_rate;
+		double drop_rate;
+		double corrupt_rate;
+		unsigned long reply_delay;
+		unsigned long reply_jitter;
+		unsigned long heartbeat_interval;
+		unsigned long next_heartbeat;
+		unsigned long underlying_interval;
+		unsigned long next_underlying;
+		bool muted;
+		bool custom_open;
+		byte presence;
+		byte motion;
+		byte amplitude;
+		byte position;
+		byte energies[5];
+		unsigned long request_count;
+		unsigned long bad_request_count;
+		unsigned long frame_count;
+		unsigned long random();
+		bool chance(double p);
+		void service();
+		void handleRequest();
+		void reply(byte control, byte command, const unsigned char* data, unsigned int length);
+		std::vector<unsigned char> frame(byte control, byte command, const unsigned char* data, unsigned int length);
+		void queue(unsigned long at, const std::vector<unsigned char>& bytes);
+		std::vector<unsigned char> setting(byte control, byte command);
+	public:
+		RadarEmulator(unsigned long seed = 1);
+
+		int available();
+		int read();
+		int peek();
+		size_t readBytes(char* buffer, size_t length);
+		using Stream::readBytes;
+		size_t write(uint8_t c);
+		using Print::write;
+
+		void setHeartbeatInterval(unsigned long ms);
+		void setUnderlyingInterval(unsigned long ms);
+		void setReplyDelay(unsigned long ms, unsigned long jitter_ms = 0);
+		void setNoise(double noise, double drop, double corrupt);
+		void setMuted(bool m);
+		void setEnergies(byte presence_energy, byte presence_gate, byte motion_energy, byte motion_gate, byte speed);
+		void setPresence(byte p);
+		void setMotion(byte m);
+		void setAmplitude(byte a);
+		void setPosition(byte p);
+
+		void scheduleFrame(unsigned long at, byte control, byte command, const unsigned char* data, unsigned int length);
+		void schedulePresence(unsigned long at, byte p);
+		void scheduleMotion(unsigned long at, byte m);
+		void injectBytes(const unsigned char* bytes, unsigned int length);
+
+		bool isCustomOpen();
+		bool isUnderlyingOn();
+		unsigned long getSetting(byte control, byte set_command);
+		unsigned long requests();
+		unsigned long badRequests();
+		unsigned long framesSent();
+		unsigned int backlog();
+};
+
+#endif
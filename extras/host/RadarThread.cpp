@@ -0,0 +1,51 @@
+/*
+ * RadarThread owns the stream side of a Radar while it runs. Stopping it joins the thread
+ * and sends anything still queued before the radar goes back to single thread use.
+ *
+ */
+
+#include "RadarThread.h"
+#include <time.h>
+
+RadarThread::RadarThread(Radar* r, unsigned long interval_us)
+	: radar(r), running(false), interval(interval_us) {
+}
+
+RadarThread::~RadarThread() {
+	stop();
+}
+
+/*!
+ * @fn start
+ * @brief puts the radar in background mode and starts the reader thread
+ */
+void RadarThread::start() {
+	if (running) return;
+	radar->setBackground(&table_lock);
+	running = true;
+	worker = std::thread(&RadarThread::run, this);
+}
+
+/*!
+ * @fn stop
+ * @brief stops the reader thread and takes the radar out of background mode
+ */
+void RadarThread::stop() {
+	if (!running) return;
+	running = false;
+	worker.join();
+	radar->setBackground(NULL);
+}
+
+/*!
+ * @fn run
+ * @brief reader loop
+ */
+void RadarThread::run() {
+	struct timespec t = {(time_t)(interval / 1000000), (long)(interval % 1000000) * 1000L};
+	while (running) {
+		radar->updateStatus();
+		if (interval > 0) nanosleep(&t, NULL);
+		else yield();
+	}
+}
@@ -0,0 +1,49 @@
+/*!
+ * @headerfile RadarThread.h
+ * @details	runs the read and parse loop of a Radar on its own std::thread on a Linux host. The
+ * 			radar is put in background mode with a std::mutex lock, events and samples reach
+ * 			other threads through RadarQueue, and commands can be submitted from any thread
+ */
+
+#ifndef RadarThread_h
+#define RadarThread_h
+
+#include "liteRadar.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/*!
+ * @class MutexLock
+ * @brief RadarLock on a std::mutex
+ */
+
+class MutexLock : public RadarLock {
+	private:
+		std::mutex m;
+	public:
+		void lock() { m.lock(); }
+		void unlock() { m.unlock(); }
+};
+
+/*!
+ * @class RadarThread
+ * @brief reader thread calling updateStatus() every interval_us
+ */
+
+class RadarThread {
+	private:
+		Radar* radar;
+		MutexLock table_lock;
+		std::thread worker;
+		std::atomic<bool> running;
+		unsigned long interval;
+		void run();
+	public:
+		RadarThread(Radar* r, unsigned long interval_us = 500);
+		~RadarThread();
+		void start();
+		void stop();
+};
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * radar_bench measures the receive and command paths of liteRadar on a Linux host.
+ *
+ *   radar_bench [options]
+ *     --frames N       frames in the synthetic stream (default 200000)
+ *     --chunk N        bytes made available per updateStatus() call, models UART rate
+ *                      against poll interval (default 64)
+ *     --noise P        chance of a random byte before each byte (default 0)
+ *     --corrupt P      chance of a frame having one bit flipped (default 0)
+ *     --replay FILE    replay a capture instead of the synthetic stream, either a
+ *                      CaptureWriter capture or raw received bytes
+ *     --commands N     command round trips to time against the emulator (default 2000)
+ *     --seed N         random seed (default 1)
+ *
+ * Throughput is frames and bytes per second of wall clock through updateStatus().
+ * Poll latency is how long one updateStatus() call takes to process a chunk, which bounds
+ * how long a frame waits after its last byte becomes readable. Resync cost is the number
+ * of good frames lost per corrupted frame. The bulk splitter is timed over the same bytes
+ * held in memory, against a plain byte by byte header search. The frame dumps are timed
+ * through updateStatus() against the per byte formatting of printFrame().
+ *
+ */
+
+#include "liteRadar.h"
+#include "RadarEmulator.h"
+#include "FrameSplitter.h"
+#include "CaptureReplay.h"
+#include "radarDump.h"
+#include <algorithm>
+#include <vector>
+#include <time.h>
+
+/*!
+ * @class BenchStream
+ * @brief memory stream that releases a byte buffer a chunk at a time
+ */
+
+class BenchStream : public Stream {
+	public:
+		const unsigned char* data;
+		size_t length;
+		size_t pos;
+		size_t limit;
+		BenchStream(const unsigned char* d, size_t l) : data(d), length(l), pos(0), limit(0) {}
+		int available() { return limit - pos; }
+		int read() { return pos < limit ? data[pos++] : -1; }
+		int peek() { return pos < limit ? data[pos] : -1; }
+		size_t readBytes(char* buffer, size_t n) {
+			if (n > limit - pos) n = limit - pos;
+			memcpy(buffer, data + pos, n);
+			pos += n;
+			return n;
+		}
+		size_t write(uint8_t) { return 1; }
+		void release(size_t n) { limit = std::min(length, limit + n); }
+};
+
+/*!
+ * @class NullPrint
+ * @brief Print that counts and throws away what is written, with unlimited room
+ */
+
+class NullPrint : public Print {
+	public:
+		unsigned long count;
+		NullPrint() : count(0) {}
+		size_t write(uint8_t) { count++; return 1; }
+		size_t write(const uint8_t*, size_t size) { count += size; return size; }
+		int availableForWrite() { return 1 << 20; }
+};
+
+static unsigned long bench_seed = 1;
+
+static unsigned long nextRandom() {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return bench_seed;
+}
+
+static bool chance(double p) {
+	return p > 0 && (nextRandom() & 0xFFFFFF) < (unsigned long)(p * 0x1000000);
+}
+
+static double nowSeconds() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void appendFrame(std::vector<unsigned char>& out, byte control, byte command,
+		const unsigned char* data, unsigned int length, bool corrupt) {
+	size_t start = out.size();
+	out.push_back(HEAD1);
+	out.push_back(HEAD2);
+	out.push_back(control);
+	out.push_back(command);
+	out.push_back((length >> 8) & 0xFF);
+	out.push_back(length & 0xFF);
+	out.insert(out.end(), data, data + length);
+	unsigned char checksum = 0;
+	for (size_t i = start; i < out.size(); i++) checksum += out[i];
+	out.push_back(checksum);
+	out.push_back(END1);
+	out.push_back(END2);
+	if (corrupt) out[start + 2 + nextRandom() % (out.size() - start - 2)] ^= 1 << (nextRandom() & 7);
+}
+
+/*!
+ * @fn buildStream
+ * @brief synthetic stream, mostly underlying data with heartbeats and status reports mixed in.
+ * 		Every frame except heartbeats ends up as a sample or a status change, so the number
+ * 		of frames the parser accepted can be counted from the outside
+ */
+static void buildStream(std::vector<unsigned char>& out, unsigned long frames,
+		double noise, double corrupt, unsigned long* corrupted, unsigned long* expected) {
+	*corrupted = 0;
+	*expected = 0;
+	for (unsigned long i = 0; i < frames; i++) {
+		while (chance(noise)) out.push_back(nextRandom() & 0xFF);
+		bool bad = chance(corrupt);
+		if (bad) (*corrupted)++;
+		else (*expected)++;
+		if (i % 50 == 0) {
+			unsigned char data[] = {0x0F};
+			appendFrame(out, SYSTEM, HEARTBEAT, data, 1, bad);
+			if (!bad) (*expected)--;
+		} else if (i % 10 == 0) {
+			unsigned char data[] = {(unsigned char)(nextRandom() % 101)};
+			appendFrame(out, HUMAN_STATUS, AMPLITUDE_DATA, data, 1, bad);
+		} else {
+			unsigned char data[] = {(unsigned char)(nextRandom() % 251), (unsigned char)(nextRandom() % 7),
+				(unsigned char)(nextRandom() % 251), (unsigned char)(nextRandom() % 9), SPEED_STATIONARY};
+			appendFrame(out, UNDERLYING, UNDERLYING_DATA, data, 5, bad);
+		}
+	}
+}
+
+static double percentile(std::vector<double>& v, double p) {
+	if (v.empty()) return 0;
+	size_t i = (size_t)(p * (v.size() - 1));
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
+
+/*!
+ * @fn benchParser
+ * @brief pushes a byte stream through updateStatus() chunk by chunk
+ */
+static void benchParser(const std::vector<unsigned char>& bytes, size_t chunk, const char* label,
+		unsigned long expected, unsigned long corrupted) {
+	BenchStream stream(&bytes[0], bytes.size());
+	Radar radar(&stream);
+	RadarSample samples[SAMPLE_BUFFER_SIZE];
+	unsigned long decoded = 0;
+	std::vector<double> latency;
+	latency.reserve(bytes.size() / chunk + 1);
+	double start = nowSeconds();
+	while (stream.limit < bytes.size()) {
+		stream.release(chunk);
+		double t = nowSeconds();
+		radar.updateStatus();
+		unsigned int n;
+		while ((n = radar.readSamples(samples, SAMPLE_BUFFER_SIZE)) > 0) decoded += n;
+		latency.push_back(nowSeconds() - t);
+	}
+	double elapsed = nowSeconds() - start;
+	Serial.printf("%s\n", label);
+	Serial.printf("  bytes            %lu in %lu chunks of %lu\n", (unsigned long)bytes.size(),
+		(unsigned long)latency.size(), (unsigned long)chunk);
+	Serial.printf("  throughput       %.0f frames/s  %.2f MB/s\n", decoded / elapsed, bytes.size() / elapsed / 1e6);
+	Serial.printf("  ns per byte      %.1f\n", elapsed * 1e9 / bytes.size());
+	Serial.printf("  poll latency     p50 %.0f ns  p90 %.0f ns  p99 %.0f ns  max %.0f ns\n",
+		percentile(latency, 0.5) * 1e9, percentile(latency, 0.9) * 1e9, percentile(latency, 0.99) * 1e9,
+		percentile(latency, 1.0) * 1e9);
+	if (expected > 0) {
+		Serial.printf("  frames decoded   %lu of %lu good", decoded, expected);
+		if (corrupted > 0) {
+			long lost = (long)expected - (long)decoded;
+			Serial.printf(", %lu corrupted, %.3f good frames lost per corruption", corrupted,
+				lost > 0 ? (double)lost / corrupted : 0.0);
+		}
+		Serial.printf("\n");
+	} else Serial.printf("  samples decoded  %lu\n", decoded);
+}
+
+/*!
+ * @fn scanHeaders
+ * @brief byte by byte header search, the baseline for findHeader
+ */
+static unsigned long scanHeaders(const unsigned char* buffer, size_t length) {
+	unsigned long found = 0;
+	for (size_t i = 0; i + 1 < length; i++) {
+		if (buffer[i] == HEAD1 && buffer[i + 1] == HEAD2) found++;
+	}
+	return found;
+}
+
+/*!
+ * @fn benchSplit
+ * @brief splits a whole capture in memory with splitFrames
+ */
+static void benchSplit(const std::vector<unsigned char>& bytes) {
+	std::vector<FrameIndex> frames;
+	frames.reserve(bytes.size() / 9);
+	SplitStats stats = {0, 0, 0, 0, 0, 0};
+	double t = nowSeconds();
+	size_t used = splitFrames(&bytes[0], bytes.size(), frames, &stats);
+	double split = nowSeconds() - t;
+	t = nowSeconds();
+	unsigned long headers = 0;
+	for (size_t i = findHeader(&bytes[0], 0, bytes.size()); i < bytes.size();
+			i = findHeader(&bytes[0], i + 1, bytes.size())) headers++;
+	double scan = nowSeconds() - t;
+	t = nowSeconds();
+	unsigned long baseline = scanHeaders(&bytes[0], bytes.size());
+	double naive = nowSeconds() - t;
+	Serial.printf("bulk split\n");
+	Serial.printf("  splitFrames      %.2f MB/s  %lu frames, %lu bad checksums, %lu bad lengths, %lu bytes skipped, %lu left over\n",
+		bytes.size() / split / 1e6, stats.frames, stats.bad_checksums, stats.bad_lengths, stats.skipped,
+		(unsigned long)(bytes.size() - used));
+	Serial.printf("  header search    %.2f MB/s  byte loop %.2f MB/s  (%lu / %lu headers)\n",
+		bytes.size() / scan / 1e6, bytes.size() / naive / 1e6, headers, baseline);
+}
+
+/*!
+ * @fn benchDump
+ * @brief runs the stream through updateStatus() with each dump format attached, and times
+ * 		the sprintf and print per byte formatting printFrame() uses on the same frames
+ */
+static void benchDump(const std::vector<unsigned char>& bytes, size_t chunk) {
+	static unsigned char ring[4096];
+	NullPrint out;
+	HexDump hex(&out, ring, sizeof(ring));
+	CsvDump csv(&out, ring, sizeof(ring));
+	RawDump raw(&out, ring, sizeof(ring));
+	DumpWriter* sinks[] = {&hex, &csv, &raw};
+	const char* names[] = {"hex", "csv", "raw"};
+	Serial.printf("frame dumps\n");
+	for (int i = 0; i < 3; i++) {
+		BenchStream stream(&bytes[0], bytes.size());
+		Radar radar(&stream);
+		radar.setDump(sinks[i]);
+		out.count = 0;
+		double t = nowSeconds();
+		while (stream.pos < stream.length) {
+			stream.release(chunk);
+			radar.updateStatus();
+		}
+		sinks[i]->flush();
+		double elapsed = nowSeconds() - t;
+		Serial.printf("  %-16s %.0f frames/s  %.2f MB/s out  %lu dropped\n", names[i], sinks[i]->dumped() / elapsed,
+			out.count / elapsed / 1e6, sinks[i]->dropped());
+	}
+	std::vector<FrameIndex> frames;
+	splitFrames(&bytes[0], bytes.size(), frames);
+	char output[4];
+	double t = nowSeconds();
+	for (size_t f = 0; f < frames.size(); f++) {
+		out.print("msg = ");
+		for (unsigned int n = 0; n < frames[f].length; n++) {
+			sprintf(output, "%02X", bytes[frames[f].offset + n]);
+			out.print(output);
+			out.print(' ');
+		}
+		out.print("  l = ");
+		out.print(frames[f].length);
+		out.println();
+	}
+	Serial.printf("  %-16s %.0f frames/s\n", "sprintf / print", frames.size() / (nowSeconds() - t));
+}
+
+/*!
+ * @fn benchCommands
+ * @brief times blocking set and get round trips against an emulator that answers at once,
+ * 		so the figures are the library and emulator cost rather than link time
+ */
+static void benchCommands(unsigned long count) {
+	if (count == 0) return;
+	RadarEmulator module(bench_seed);
+	module.setReplyDelay(0);
+	module.setHeartbeatInterval(0);
+	Radar radar(&module);
+	std::vector<double> set_times;
+	std::vector<double> get_times;
+	set_times.reserve(count);
+	get_times.reserve(count);
+	unsigned long failures = 0;
+	for (unsigned long i = 0; i < count; i++) {
+		double t = nowSeconds();
+		if (!radar.setPresenceThreshold(i & 0xFF)) failures++;
+		set_times.push_back(nowSeconds() - t);
+		radar.invalidateConfig();
+		t = nowSeconds();
+		if (radar.getPresenceThreshold() != (i & 0xFF)) failures++;
+		get_times.push_back(nowSeconds() - t);
+	}
+	Serial.printf("command round trips (emulator, no link delay)\n");
+	Serial.printf("  set              p50 %.2f us  p99 %.2f us  max %.2f us\n", percentile(set_times, 0.5) * 1e6,
+		percentile(set_times, 0.99) * 1e6, percentile(set_times, 1.0) * 1e6);
+	Serial.printf("  get              p50 %.2f us  p99 %.2f us  max %.2f us\n", percentile(get_times, 0.5) * 1e6,
+		percentile(get_times, 0.99) * 1e6, percentile(get_times, 1.0) * 1e6);
+	Serial.printf("  failures         %lu of %lu\n", failures, count * 2);
+}
+
+int main(int argc, char** argv) {
+	unsigned long frames = 200000;
+	unsigned long commands = 2000;
+	size_t chunk = 64;
+	double noise = 0;
+	double corrupt = 0;
+	const char* replay = NULL;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--frames")) frames = atol(argv[i + 1]);
+		else if (!strcmp(argv[i], "--chunk")) chunk = atol(argv[i + 1]);
+		else if (!strcmp(argv[i], "--noise")) noise = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "--corrupt")) corrupt = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "--replay")) replay = argv[i + 1];
+		else if (!strcmp(argv[i], "--commands")) commands = atol(argv[i + 1]);
+		else if (!strcmp(argv[i], "--seed")) bench_seed = atol(argv[i + 1]);
+		else {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (chunk == 0) chunk = 1;
+	if (bench_seed == 0) bench_seed = 1;
+
+	std::vector<unsigned char> bytes;
+	if (replay != NULL) {
+		FILE* f = fopen(replay, "rb");
+		if (f == NULL) {
+			perror(replay);
+			return 2;
+		}
+		unsigned char buffer[65536];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+		fclose(f);
+		if (bytes.empty()) return 2;
+		CaptureReplay capture;
+		if (capture.load(&bytes[0], bytes.size())) bytes = capture.received();	// keep the received side
+		benchParser(bytes, chunk, replay, 0, 0);
+		benchSplit(bytes);
+	} else {
+		unsigned long corrupted, expected;
+		buildStream(bytes, frames, 0, 0, &corrupted, &expected);
+		benchParser(bytes, chunk, "clean stream", expected, 0);
+		benchSplit(bytes);
+		benchDump(bytes, chunk);
+		if (noise > 0 || corrupt > 0) {
+			bytes.clear();
+			buildStream(bytes, frames, noise, corrupt, &corrupted, &expected);
+			benchParser(bytes, chunk, "noisy stream", expected, corrupted);
+			benchSplit(bytes);
+		}
+	}
+	benchCommands(commands);
+	return 0;
+}
@@ -0,0 +1,558 @@
+/*
+ * emulated_sensor runs the same bring up as the occupancy sensor example against the module
+ * emulator on a Linux host, then plays a short presence and motion script through it.
+ * It exits non zero if anything does not behave, so it can be run in CI.
+ *
+ */
+
+#include "liteRadar.h"
+#include "radarProfile.h"
+#include "radarHistory.h"
+#include "radarAmplitude.h"
+#include "radarCapture.h"
+#include "radarQueue.h"
+#include "radarPublisher.h"
+#include "radarDump.h"
+#include "radarZones.h"
+#include "radarCalibration.h"
+#include "RadarEmulator.h"
+#include "CaptureReplay.h"
+#include "FrameSplitter.h"
+#include "RadarThread.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+/*!
+ * @class MemoryPrint
+ * @brief Print that keeps everything written to it, stands in for an SD card file
+ */
+
+class MemoryPrint : public Print {
+	public:
+		std::vector<unsigned char> bytes;
+		int room;
+		MemoryPrint(int r = 0) : room(r) {}
+		size_t write(uint8_t c) { bytes.push_back(c); return 1; }
+		using Print::write;
+		int availableForWrite() { return room; }
+};
+
+/*!
+ * @fn dumpFor
+ * @brief runs the radar for ms with a dump sink attached
+ * @returns number of frames the radar received meanwhile
+ */
+static unsigned long dumpFor(Radar* radar, RadarDumpSink* sink, unsigned long ms) {
+	RadarCounters before;
+	RadarCounters after;
+	radar->getCounters(&before);
+	radar->setDump(sink);
+	unsigned long start = millis();
+	while (millis() - start < ms) radar->updateStatus();
+	radar->setDump(NULL);
+	radar->getCounters(&after);
+	unsigned long received = 0;
+	for (int i = 0; i < COUNT_CONTROLS; i++) received += after.frames[i] - before.frames[i];
+	return received;
+}
+
+static unsigned long countLines(const std::vector<unsigned char>& bytes, const char* prefix) {
+	unsigned long n = 0;
+	size_t line = 0;
+	for (size_t i = 0; i < bytes.size(); i++) {
+		if (bytes[i] != '\n') continue;
+		if (prefix == NULL || (i - line > strlen(prefix) && memcmp(&bytes[line], prefix, strlen(prefix)) == 0)) n++;
+		line = i + 1;
+	}
+	return n;
+}
+
+static void countTransition(const RadarEvent* event, void* context) {
+	if (event->type == EVENT_PRESENCE || event->type == EVENT_MOTION) (*(int*)context)++;
+}
+
+/*!
+ * @fn replayTransitions
+ * @brief replays a capture into a fresh Radar and counts its presence and motion transitions
+ */
+static int replayTransitions(MemoryPrint* capture, double speed, bool* present) {
+	CaptureReplay replay;
+	if (!replay.load(&capture->bytes[0], capture->bytes.size())) return -1;
+	replay.setSpeed(speed);
+	Radar radar(&replay);
+	int transitions = 0;
+	radar.onEvent(countTransition, &transitions);
+	while (!replay.finished()) radar.updateStatus();
+	*present = radar.isPresent();
+	return transitions;
+}
+
+static void hostSleep(unsigned long ms, void* context) {
+	(*(int*)context)++;
+	delay(ms);											// moves the manual clock on
+}
+
+static void recordPublished(const RadarEvent* event, void* context) {
+	if (event->type == EVENT_PRESENCE) ((std::vector<RadarEvent>*)context)->push_back(*event);
+}
+
+/*!
+ * @class FrameCheck
+ * @brief slow dump sink that checks each frame is left alone while it holds it
+ */
+
+class FrameCheck : public RadarDumpSink {
+	public:
+		unsigned long frames;
+		unsigned long changed;
+		FrameCheck() : frames(0), changed(0) {}
+		void dump(unsigned long t, const FrameView* frame) {
+			std::vector<unsigned char> copy(frame->msg, frame->msg + frame->l);
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			if (memcmp(&copy[0], frame->msg, frame->l) != 0) changed++;
+			frames++;
+		}
+};
+
+struct ZoneChange {
+	byte zone;
+	bool occupied;
+	unsigned long visit;
+};
+
+static void recordZone(byte zone, bool occupied, unsigned long visit, void* context) {
+	ZoneChange change = {zone, occupied, visit};
+	((std::vector<ZoneChange>*)context)->push_back(change);
+}
+
+static void check(bool ok, const char* what) {
+	Serial.printf("%-40s %s\n", what, ok ? "ok" : "FAILED");
+	if (!ok) failures++;
+}
+
+int main(int argc, char** argv) {
+	hostManualClock(20);								// 20us per clock read, deterministic
+	unsigned long seed = argc > 1 ? atol(argv[1]) : 1;
+	RadarEmulator module(seed);
+	if (argc > 2) module.setNoise(atof(argv[2]), atof(argv[2]), 0);
+	Radar radar(&module);
+
+	check(radar.resetRadar(), "reset");
+	check(radar.setUnderlying(0x00), "underlying off");
+	check(radar.readConfig(), "read config");
+
+	RadarProfile profile(MODE_1);
+	profile.setPresenceThreshold(0x1E);
+	profile.setPresenceRange(0x09);
+	profile.setStationaryValidTime(10000);
+	profile.setMotionThreshold(0x0E);
+	profile.setMotionRange(0x09);
+	profile.setMotionValidTime(3000);
+	check(!profile.set(PROFILE_PARAMS, 0), "profile rejects unknown parameter");
+	check(profile.apply(&radar), "custom mode profile");
+	check(module.getSetting(CUSTOM, SET_PRESENCE_THRESHOLD) == 0x1E, "module presence threshold");
+	check(module.getSetting(CUSTOM, SET_MOTION_VALID_TIME) == 3000, "module motion valid time");
+	check(radar.getStationaryValidTime() == 10000, "cached stationary valid time");
+	check(!module.isCustomOpen(), "custom mode closed");
+	RadarConfig snapshot;
+	bool complete = radar.getConfig(&snapshot);
+	check(radar.openCustomMode(MODE_2) && radar.exitCustomMode(), "other custom mode");
+	check(complete && !radar.getConfig(&snapshot) && radar.readConfig() && radar.getConfig(&snapshot), "cache dropped on a mode change");
+	check(radar.resetRadar() && !radar.getConfig(&snapshot) && radar.readConfig(), "cache dropped on reset");
+	RadarConfig desired;
+	radar.getConfig(&desired);
+	desired.mode = (desired.mode == MODE_3) ? MODE_4 : MODE_3;
+	desired.motion_threshold = desired.motion_threshold + 1;
+	RadarCounters mode_before;
+	radar.getCounters(&mode_before);
+	bool mode_applied = radar.applyConfig(&desired);
+	RadarCounters mode_after;
+	radar.getCounters(&mode_after);
+	check(mode_applied && mode_after.commands - mode_before.commands == 2 + 7 && radar.getConfig(&snapshot) &&
+		snapshot.mode == desired.mode, "apply config to another mode");
+	unsigned char threshold_data[] = {0x00, 0x00, 0x00, 0x1E};
+	int held_handles[MAX_PENDING];
+	for (int i = 0; i < MAX_PENDING; i++) held_handles[i] = radar.submitGet(HUMAN_STATUS, GET_PRESENCE_EVENT);	// never collected
+	check(radar.submitGet(HUMAN_STATUS, GET_PRESENCE_EVENT) == SUBMIT_BUSY &&
+		radar.submitSet(HUMAN_STATUS, GET_PRESENCE_EVENT, threshold_data) == SUBMIT_INVALID, "busy and invalid submits");
+	RadarCounters held_before;
+	radar.getCounters(&held_before);
+	unsigned long held_start = millis();
+	bool read_held = radar.readConfig();
+	unsigned long read_took = millis() - held_start;
+	RadarCounters held_after;
+	radar.getCounters(&held_after);
+	RadarProfile held_profile(MODE_1);
+	held_profile.setMotionThreshold(0x0E);
+	held_profile.setUnderlying(0x00);
+	unsigned long profile_start = millis();
+	bool profile_held = held_profile.apply(&radar);
+	for (int i = 0; i < MAX_PENDING; i++) radar.cancelCommand(held_handles[i]);
+	check(!read_held && read_took < 2 * TIME_TO_WAIT && held_after.busy == held_before.busy,
+		"read config gives up on a full table");
+	check(!profile_held && millis() - profile_start < 2 * TIME_TO_WAIT && !module.isCustomOpen() &&
+		held_profile.result().failed == ((1 << PROFILE_MOTION_THRESHOLD) | (1 << PARAM_UNDERLYING)),
+		"profile gives up on a full table");
+
+	HistoryEntry entries[16];
+	RadarHistory history(entries, 16);
+	radar.setHistory(&history);
+
+	MemoryPrint capture;
+	CaptureWriter writer(&capture);
+	writer.begin();
+	radar.setCapture(&writer);
+
+	unsigned long start = millis();
+	module.schedulePresence(start + 100, 0x01);
+	module.scheduleMotion(start + 200, 0x02);
+	module.scheduleMotion(start + 400, 0x01);
+	module.schedulePresence(start + 600, 0x00);
+	int changes = 0;
+	bool was_present = false;
+	bool was_moving = false;
+	while (millis() - start < 800) {
+		if (radar.updateStatus()) {
+			changes++;
+			was_present = was_present || radar.isPresent();
+			was_moving = was_moving || radar.isMoving();
+		}
+	}
+	check(was_present && was_moving, "presence and motion seen");
+	check(!radar.isPresent() && !radar.isMoving(), "absent at end of script");
+	radar.setCapture(NULL);
+	bool replay_present = true;
+	check(replayTransitions(&capture, 4.0, &replay_present) == 4 && !replay_present, "capture replayed at 4x");
+	check(replayTransitions(&capture, REPLAY_AS_FAST_AS_POSSIBLE, &replay_present) == 4 && !replay_present,
+		"capture replayed at full speed");
+	check(history.size() == 4, "history transitions");
+	unsigned long occupied = history.occupiedTime(800, millis());
+	check(occupied >= 400 && occupied <= 600, "history occupied time");
+	HistoryEntry wrap_entries[4];
+	RadarHistory wrap(wrap_entries, 4);
+	unsigned long before_wrap = (unsigned long)-1500;				// millis() about to wrap
+	wrap.record(before_wrap, 0x01, 0x00);
+	wrap.record(before_wrap + 1000, 0x00, 0x00);
+	wrap.record(before_wrap + 2000, 0x01, 0x00);					// past the wrap
+	wrap.record(before_wrap + 1900, 0x00, 0x00);					// a clock that went back
+	unsigned long wrap_t = 0;
+	byte wrap_state = 0;
+	check(wrap.size() == 4 && wrap.entry(2, &wrap_t, &wrap_state) && wrap_t == before_wrap + 2000 &&
+		wrap.occupiedTime(3000, before_wrap + 2500) == 1000 && wrap.transitions(3000, before_wrap + 2500) == 3,
+		"history across a millis() wrap");
+
+	byte window[8];
+	byte extremes[2 * 8];
+	RadarAmplitude amplitude(window, extremes, 8);
+	radar.setAmplitudeStats(&amplitude);
+	static const byte amplitudes[] = {60, 70, 80, 70};
+	for (unsigned int i = 0; i < sizeof(amplitudes); i++) {
+		module.setAmplitude(amplitudes[i]);
+		start = millis();
+		while (millis() - start < 20) radar.updateStatus();
+	}
+	check(amplitude.samples() == 4 && amplitude.mean() == 70 * AMPLITUDE_ONE, "amplitude mean");
+	check(amplitude.minimum() == 60 && amplitude.maximum() == 80, "amplitude min max");
+	check(amplitude.level() == ACTIVITY_HIGH, "amplitude activity level");
+	byte sliding_window[5];
+	byte sliding_extremes[2 * 5];
+	RadarAmplitude sliding(sliding_window, sliding_extremes, 5);
+	std::vector<byte> reports;
+	bool extremes_match = true;
+	for (int i = 0; i < 200; i++) {
+		byte report = (i % 37 < 20) ? 30 : (byte)((i * 7919) % 101);	// a quiet stretch, then noise
+		sliding.add(report);
+		reports.push_back(report);
+		byte low = 0xFF;
+		byte high = 0;
+		for (size_t j = reports.size() > 5 ? reports.size() - 5 : 0; j < reports.size(); j++) {
+			if (reports[j] < low) low = reports[j];
+			if (reports[j] > high) high = reports[j];
+		}
+		if (sliding.minimum() != low || sliding.maximum() != high) extremes_match = false;
+	}
+	check(extremes_match, "amplitude min max sliding");
+
+	radar.setHeartbeatTimeout(1500);
+	radar.setRecoveryProfile(&profile);
+	module.setMuted(true);								// wedge the module
+	bool degraded = false;
+	bool lost = false;
+	start = millis();
+	while (millis() - start < 4000) {
+		radar.updateStatus();
+		degraded = degraded || radar.linkState() == LINK_DEGRADED;
+		lost = lost || radar.linkState() == LINK_LOST;
+	}
+	check(degraded && lost, "silent link detected");
+	module.setMuted(false);
+	start = millis();
+	while (millis() - start < 3 * TIME_TO_WAIT) {
+		radar.updateStatus();
+		if (radar.recoveryState() == RECOVER_IDLE && radar.linkState() == LINK_HEALTHY) break;
+	}
+	check(radar.linkState() == LINK_HEALTHY, "link recovered");
+	check(profile.ok() && !module.isCustomOpen(), "profile reapplied after reset");
+
+	int sleeps = 0;
+	radar.onSleep(hostSleep, &sleeps);
+	check(radar.setPresenceThreshold(0x1E) && sleeps > 0, "set sleeping between polls");
+	radar.onSleep(NULL);
+	radar.setLatencyBound(50);
+	start = millis();
+	module.schedulePresence(start + 1130, 0x01);
+	module.schedulePresence(start + 2470, 0x00);
+	unsigned long seen_present = 0;
+	unsigned long seen_absent = 0;
+	int wakes = 0;
+	while (millis() - start < 3000) {
+		if (radar.updateStatus()) {
+			if (radar.isPresent()) seen_present = millis() - start;
+			else seen_absent = millis() - start;
+		}
+		wakes++;
+		unsigned long ms = radar.sleepUntil() - millis();
+		if ((long)ms > 0) delay(ms);
+	}
+	check(seen_present >= 1130 && seen_present <= 1130 + 50 && seen_absent >= 2470 && seen_absent <= 2470 + 50,
+		"presence seen within the latency bound");
+	check(wakes <= 2 * 3000 / 50, "polls while sleeping");
+	check(radar.heartbeatPeriod() >= 990 && radar.heartbeatPeriod() <= 1010, "heartbeat period learned");
+
+	RadarPublisher publisher;
+	publisher.setHysteresis(EVENT_PRESENCE, 0, 500);
+	std::vector<RadarEvent> published;
+	publisher.onPublish(recordPublished, &published);
+	radar.setPublisher(&publisher);
+	start = millis();
+	static const unsigned long flaps[] = {100, 200, 300, 400, 450, 1600};
+	for (unsigned int i = 0; i < sizeof(flaps) / sizeof(flaps[0]); i++) {
+		module.schedulePresence(start + flaps[i], i % 2 == 0 ? 0x01 : 0x00);
+	}
+	while (millis() - start < 2500) radar.updateStatus();
+	radar.setPublisher(NULL);
+	check(published.size() == 2 && published[0].current == 0x01 && published[0].t - start <= 110, "first edge published");
+	check(published.size() == 2 && published[1].current == 0x00 && published[1].t - start >= 2100, "flaps coalesced");
+	check(publisher.published() == 2 && publisher.suppressed() == 4, "suppressed transitions");
+
+	unsigned long timeout = radar.commandTimeout(CUSTOM);
+	check(timeout >= RTO_MIN * 1000UL && timeout < RTO_INITIAL * 1000UL, "reply timeout from round trips");
+	RadarCounters before;
+	radar.getCounters(&before);
+	unsigned char threshold[] = {0x00, 0x00, 0x00, 0x0E};
+	module.setMuted(true);								// the first request goes unanswered
+	int handle = radar.submitSet(CUSTOM, SET_MOTION_THRESHOLD, threshold);
+	start = millis();
+	while (millis() - start < 5) radar.updateStatus();
+	module.setMuted(false);
+	while (radar.commandState(handle) == CMD_PENDING) radar.updateStatus();
+	RadarCounters after;
+	radar.getCounters(&after);
+	check(radar.commandResult(handle, NULL) && after.retries > before.retries && millis() - start < 200,
+		"lost request sent again");
+	module.setMuted(true);
+	start = millis();
+	byte timeout_result = RESULT_OK;
+	check(!radar.setMotionThreshold(0x0E, &timeout_result) && timeout_result == RESULT_TIMEOUT &&
+		radar.lastResult() == RESULT_TIMEOUT && millis() - start < 1000, "timeout after retries");
+	module.setMuted(false);
+	RadarEmulator corrupt_module(seed);
+	corrupt_module.setMuted(true);
+	Radar corrupt_radar(&corrupt_module);
+	handle = corrupt_radar.submitSet(CUSTOM, SET_MOTION_THRESHOLD, threshold);
+	static const unsigned char bad_heartbeat[] = {HEAD1, HEAD2, SYSTEM, HEARTBEAT, 0x00, 0x01, 0x0F, 0x00, END1, END2};
+	corrupt_module.injectBytes(bad_heartbeat, sizeof(bad_heartbeat));
+	while (corrupt_radar.commandState(handle) == CMD_PENDING) corrupt_radar.updateStatus();
+	check(!corrupt_radar.commandResult(handle, NULL) && corrupt_radar.lastResult() == RESULT_CHECKSUM, "checksum error result");
+
+	check(radar.setUnderlying(0x01), "underlying on");
+	unsigned char ring[256];
+	MemoryPrint hex_out(64);
+	HexDump hex(&hex_out, ring, sizeof(ring));
+	unsigned long dumped_frames = dumpFor(&radar, &hex, 500);
+	hex.flush();
+	check(dumped_frames >= 5 && hex.dumped() == dumped_frames && hex.dropped() == 0 && countLines(hex_out.bytes, NULL) == dumped_frames,
+		"hex dump");
+	MemoryPrint csv_out(64);
+	CsvDump csv(&csv_out, ring, sizeof(ring));
+	csv.begin();
+	dumped_frames = dumpFor(&radar, &csv, 500);
+	csv.flush();
+	check(csv.dumped() == dumped_frames && countLines(csv_out.bytes, "t,report,") == 1 &&
+		countLines(csv_out.bytes, NULL) == dumped_frames + 1 && countLines(csv_out.bytes, NULL) - countLines(csv_out.bytes, "heartbeat") >= 5,
+		"csv dump");
+	MemoryPrint raw_out;										// a file, cannot tell its room
+	unsigned char odd_ring[100];								// any size works, not just powers of two
+	RawDump raw(&raw_out, odd_ring, sizeof(odd_ring), false);
+	dumped_frames = dumpFor(&radar, &raw, 500);
+	raw.flush();
+	std::vector<FrameIndex> frames;
+	splitFrames(&raw_out.bytes[0], raw_out.bytes.size(), frames);
+	check(raw.dumped() == dumped_frames && frames.size() == dumped_frames, "raw dump");
+	MemoryPrint slow_out(4);
+	unsigned char small_ring[64];
+	HexDump slow(&slow_out, small_ring, sizeof(small_ring));
+	dumped_frames = dumpFor(&radar, &slow, 500);
+	check(slow.dropped() > 0 && slow.dumped() + slow.dropped() == dumped_frames, "slow print drops frames, not bytes");
+	RadarZone zone_storage[2];
+	RadarZones zones(zone_storage, 2);
+	std::vector<ZoneChange> zone_changes;
+	int desk = zones.addZone(2, 3, recordZone, &zone_changes);
+	int door = zones.addZone(6, 8, recordZone, &zone_changes);
+	zones.setHold(500);
+	radar.setZones(&zones);
+	module.setEnergies(40, 2, 0, 0, SPEED_STATIONARY);		// someone sitting at the desk
+	start = millis();
+	while (millis() - start < 1000) radar.updateStatus();
+	check(zones.occupied(desk) && !zones.occupied(door), "desk zone occupied");
+	module.setEnergies(40, 2, 60, 7, 10);					// and someone at the door
+	while (millis() - start < 1500) radar.updateStatus();
+	check(zones.occupied(desk) && zones.occupied(door), "door zone occupied");
+	module.setEnergies(0, 0, 0, 0, SPEED_STATIONARY);
+	while (millis() - start < 2500) radar.updateStatus();
+	check(!zones.occupied(desk) && !zones.occupied(door) && zone_changes.size() == 4 &&
+		zone_changes[2].zone == desk && !zone_changes[2].occupied && zone_changes[3].zone == door && !zone_changes[3].occupied,
+		"zones vacated after the hold");
+	unsigned long desk_dwell = zones.dwell(desk, millis());
+	unsigned long door_dwell = zones.dwell(door, millis());
+	check(desk_dwell >= 1300 && desk_dwell <= 1500 && door_dwell >= 300 && door_dwell <= 500 &&
+		zone_changes[2].visit == desk_dwell && zones.visits(desk) == 1, "zone dwell times");
+	module.setPosition(POSITION_APPROACHING);
+	while (millis() - start < 2600) radar.updateStatus();
+	check(zones.position() == POSITION_APPROACHING, "direction from position report");
+	radar.setZones(NULL);
+	check(radar.setUnderlying(0x00), "underlying off again");
+	RadarCalibration calibration;
+	calibration.setRange(0x0A, 0x09);
+	check(calibration.begin(&radar, 2000), "calibration started");
+	module.setEnergies(12, 3, 8, 9, SPEED_STATIONARY);		// background of an empty room
+	start = millis();
+	while (!calibration.poll()) {
+		radar.updateStatus();
+		unsigned long t = millis() - start;
+		if (t >= 600 && t < 1200) module.setEnergies(16, 3, 6, 9, SPEED_STATIONARY);
+		else if (t >= 1200 && t < 1300) module.setEnergies(150, 10, 6, 9, SPEED_STATIONARY);	// a fan at the far end
+		else module.setEnergies(12, 3, 8, 9, SPEED_STATIONARY);
+	}
+	module.setEnergies(0, 0, 0, 0, SPEED_STATIONARY);
+	check(calibration.ok() && !module.isUnderlyingOn(), "calibration done, underlying off");
+	check(calibration.samples(false, 3) >= 10 && calibration.mean(false, 3) >= 12 && calibration.mean(false, 3) <= 16 &&
+		calibration.peak(false, 3) == 16 && calibration.deviation(false, 3) >= 1, "background energy per gate");
+	check(calibration.presenceRange() == 0x09 && calibration.motionRange() == 0x09, "noisy far gate cut off the range");
+	check(calibration.presenceThreshold() == calibration.gateThreshold(false, 3) && calibration.presenceThreshold() > 16 &&
+		calibration.motionThreshold() == calibration.gateThreshold(true, 9) && calibration.motionThreshold() > 8,
+		"thresholds above the noise floor");
+	RadarProfile calibrated(MODE_1);
+	calibration.suggest(&calibrated);
+	check(calibrated.apply(&radar) && module.getSetting(CUSTOM, SET_PRESENCE_THRESHOLD) == calibration.presenceThreshold() &&
+		module.getSetting(CUSTOM, SET_MOTION_RANGE) == 0x09, "calibrated thresholds applied");
+	Radar other_radar(&module);									// turns underlying data on behind the cache
+	RadarCalibration brief;
+	check(other_radar.setUnderlying(0x01) && brief.calibrate(&radar, 300) && module.isUnderlyingOn() && radar.setUnderlying(0x00),
+		"calibration keeps underlying data on");
+	RadarCalibration late;
+	late.begin(&radar, 300);
+	while (late.getState() == CALIBRATION_READING) {
+		radar.updateStatus();
+		late.poll();
+	}
+	module.setMuted(true);								// the first on ack is lost
+	start = millis();
+	while (millis() - start < 10) {
+		radar.updateStatus();
+		late.poll();
+	}
+	module.setMuted(false);
+	module.setReplyDelay(10000);							// and the others come after the last retry
+	while (!late.poll()) radar.updateStatus();
+	module.setReplyDelay(2);
+	start = millis();
+	while (millis() - start < 10000) radar.updateStatus();	// late acks drain
+	check(late.getState() == CALIBRATION_FAILED && !module.isUnderlyingOn(), "failed calibration turns underlying data off");
+	for (int i = 0; i < MAX_PENDING; i++) held_handles[i] = radar.submitGet(HUMAN_STATUS, GET_PRESENCE_EVENT);
+	RadarCalibration crowded;
+	unsigned long crowded_start = millis();
+	bool crowded_ok = crowded.calibrate(&radar, 300);
+	for (int i = 0; i < MAX_PENDING; i++) radar.cancelCommand(held_handles[i]);
+	check(!crowded_ok && crowded.getState() == CALIBRATION_FAILED && millis() - crowded_start < 2 * TIME_TO_WAIT,
+		"calibration gives up on a full table");
+	FrameCheck held;
+	radar.setDump(&held);
+	unsigned char heartbeat[] = {HEAD1, HEAD2, SYSTEM, HEARTBEAT, 0x00, 0x01, 0x0F, 0x00, END1, END2};
+	heartbeat[7] = frameChecksum(heartbeat, sizeof(heartbeat));
+	unsigned long injected = 64;								// more than the receive buffer holds
+	for (unsigned long i = 0; i < injected; i++) module.injectBytes(heartbeat, sizeof(heartbeat));
+	RadarCounters push_before;
+	radar.getCounters(&push_before);
+	MemoryPrint push_capture;
+	CaptureWriter push_writer(&push_capture);
+	radar.setCapture(&push_writer);
+	bool push_refused = !radar.setReceiveMode(RECEIVE_PUSH);
+	radar.setCapture(NULL);
+	check(push_refused && radar.setReceiveMode(RECEIVE_PUSH) && !radar.setCapture(&push_writer), "no capture in push mode");
+	std::atomic<bool> producing(true);
+	std::thread producer([&]() {							// stands in for the uart receive callback
+		while (producing) radar.receive();
+	});
+	start = millis();
+	while (held.frames < injected && millis() - start < 10000) {
+		radar.updateStatus();
+		yield();
+	}
+	producing = false;
+	producer.join();
+	radar.setReceiveMode(RECEIVE_POLL);
+	radar.setDump(NULL);
+	RadarCounters push_after;
+	radar.getCounters(&push_after);
+	check(held.frames >= injected && held.changed == 0 && push_after.bad_checksums == push_before.bad_checksums,
+		"frames intact in push mode");
+	RadarEvent event_storage[8];
+	RadarQueue<RadarEvent> events(event_storage);
+	int odd_storage[6];
+	RadarQueue<int> odd(odd_storage, 6);
+	int odd_pushed = 0;
+	for (int i = 0; i < 6; i++) odd_pushed += odd.push(i) ? 1 : 0;
+	check(odd_pushed == 4 && odd.drops() == 2, "queue rounded down to a power of two");
+	radar.setEventQueue(&events);
+	start = millis();
+	module.schedulePresence(start + 100, 0x01);				// the emulator belongs to the reader from here
+	module.scheduleMotion(start + 150, 0x02);
+	RadarThread reader(&radar);
+	reader.start();
+	byte thread_set = RESULT_INVALID;
+	check(radar.setPresenceThreshold(0x20, &thread_set) && thread_set == RESULT_OK, "set from another thread");
+	radar.invalidateConfig();
+	byte thread_get = RESULT_INVALID;
+	check(radar.getMotionRange(&thread_get) == 0x09 && thread_get == RESULT_OK, "get from another thread");
+	RadarCounters live;
+	radar.getCounters(&live);
+	check(live.replies > 0 && live.frames[COUNT_SYSTEM] > 0 && radar.lastResult() == RESULT_OK, "counters from another thread");
+	int queued = 0;
+	RadarEvent event;
+	while (queued < 2 && millis() - start < 1000) {
+		if (events.pop(&event) && (event.type == EVENT_PRESENCE || event.type == EVENT_MOTION)) queued++;
+		else yield();
+	}
+	reader.stop();
+	radar.setEventQueue(NULL);
+	check(queued == 2 && radar.isPresent() && radar.isMoving(), "events from the reader thread");
+	check(module.getSetting(CUSTOM, SET_PRESENCE_THRESHOLD) == 0x20, "module set from another thread");
+
+	RadarCounters counters;
+	radar.getCounters(&counters);
+	unsigned long received = 0;
+	for (int i = 0; i < COUNT_CONTROLS; i++) received += counters.frames[i];
+	check(counters.replies > 0 && counters.rtt_min <= counters.rtt_avg && counters.rtt_avg <= counters.rtt_max, "command round trip counters");
+	check(received <= module.framesSent() + injected && counters.frames[COUNT_SYSTEM] > 0, "frame counters");
+	if (argc <= 2) check(counters.bad_checksums == 0 && counters.resync_bytes == 0, "clean link counters");
+	Serial.printf("status changes %d, requests %lu, frames sent %lu\n", changes, module.requests(), module.framesSent());
+	Serial.printf("frames received %lu, ignored %lu, commands %lu, replies %lu, retries %lu, timeouts %lu, rtt %lu/%lu/%lu us\n",
+		received, counters.ignored, counters.commands, counters.replies, counters.retries, counters.timeouts,
+		counters.rtt_min, counters.rtt_avg, counters.rtt_max);
+	return failures ? 1 : 0;
+}
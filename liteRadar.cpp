@@ -9,10 +9,119 @@
 
 
 #include "liteRadar.h"
+#include "radarProfile.h"
+#include "radarHistory.h"
+#include "radarAmplitude.h"
+#include "radarCapture.h"
+#include "radarQueue.h"
+#include "radarPublisher.h"
+#include "radarDump.h"
+#include "radarZones.h"
+
+// how each PARAM_ parameter is read and written, indexed by PARAM_ parameter
+#define RADAR_PARAM(ctrl, set, get) \
+	{ctrl, set, get, RadarCommand<ctrl, set>::width, RadarRequest<ctrl, get>::frame}
+
+const RadarParamInfo radar_params[PARAM_COUNT] = {
+	RADAR_PARAM(CUSTOM, SET_PRESENCE_THRESHOLD, GET_PRESENCE_THRESHOLD),
+	RADAR_PARAM(CUSTOM, SET_PRESENCE_RANGE, GET_PRESENCE_RANGE),
+	RADAR_PARAM(CUSTOM, SET_MOTION_THRESHOLD, GET_MOTION_THRESHOLD),
+	RADAR_PARAM(CUSTOM, SET_MOTION_RANGE, GET_MOTION_RANGE),
+	RADAR_PARAM(CUSTOM, SET_MOTION_VALID_TIME, GET_MOTION_VALID_TIME),
+	RADAR_PARAM(CUSTOM, SET_STATIONARY_VALID_TIME, GET_STATIONARY_VALID_TIME),
+	RADAR_PARAM(CUSTOM, SET_ABSENCE_VALID_TIME, GET_ABSENCE_VALID_TIME),
+#ifndef RADAR_NO_SCENARIOS
+	RADAR_PARAM(WORKING_STATUS, SET_SCENARIO, GET_SCENARIO),
+	RADAR_PARAM(WORKING_STATUS, SET_SENSITIVITY, GET_SENSITIVITY),
+	RADAR_PARAM(HUMAN_STATUS, SET_TIME_OF_ABSENCE, GET_TIME_OF_ABSENCE),
+#else
+	{0, 0, 0, 0, NULL},
+	{0, 0, 0, 0, NULL},
+	{0, 0, 0, 0, NULL},
+#endif
+	RADAR_PARAM(UNDERLYING, SET_UNDERLYING, GET_UNDERLYING)
+};
 
 Radar::Radar(Stream *s)
-	: stream(s) {
-	
+	: stream(s), presence(false), motion(0), rx_head(0), rx_start(0), rx_tail(0), rx_pos(0), receive_mode(RECEIVE_POLL),
+	  rx_state(PARSE_HEAD1), rx_checksum(0), rx_length(0), rx_count(0), status_changed(false),
+	  config_valid(0), last_result(RESULT_OK), sample_head(0), sample_tail(0), event_callback(NULL), event_context(NULL),
+	  history(NULL), amplitude_stats(NULL), publisher(NULL), zones(NULL), link_timeout(0), last_seen(0), recovery_started(0),
+	  link(LINK_HEALTHY), recovery(RECOVER_IDLE), recovery_handle(-1), recovery_profile(NULL),
+	  capture_sink(NULL), dump_sink(NULL), table_lock(NULL), event_queue(NULL), sample_queue(NULL),
+	  byte_time(10000000UL / RADAR_BAUD), latency_bound(PRESENCE_LATENCY), sleep_callback(NULL), sleep_context(NULL) {
+	rx.l = 0;
+	memset(srtt, 0, sizeof(srtt));
+	memset(rttvar, 0, sizeof(rttvar));
+	memset(&heartbeats, 0, sizeof(heartbeats));
+	memset(&reports, 0, sizeof(reports));
+	for (int i = 0; i < MAX_PENDING; i++) pending[i].state = CMD_FREE;
+	resetCounters();
+	memset(&config, 0, sizeof(config));
+	config.mode = MODE_1;
+}
+
+/*!
+ * @fn frameChecksum
+ * @brief sums the bytes of a frame that the checksum covers, header to last data byte
+ * @param msg complete frame
+ * @param length length of the whole frame, header to trailer
+ * @returns the checksum the frame should carry
+ */
+byte frameChecksum(const unsigned char* msg, unsigned int length) {
+	byte checksum = 0;
+	for (unsigned int i = 0; i < length - 3; i++) {
+		checksum = checksum + msg[i];
+	}
+	return checksum;
+}
+
+/*!
+ * @fn configValue
+ * @brief reads one parameter out of a configuration snapshot
+ * @param config snapshot to read
+ * @param param PARAM_ parameter
+ * @returns value of the parameter
+ */
+unsigned long configValue(const RadarConfig* config, byte param) {
+	switch (param) {
+		case PARAM_PRESENCE_THRESHOLD:		return config->presence_threshold;
+		case PARAM_PRESENCE_RANGE:			return config->presence_range;
+		case PARAM_MOTION_THRESHOLD:		return config->motion_threshold;
+		case PARAM_MOTION_RANGE:			return config->motion_range;
+		case PARAM_MOTION_VALID_TIME:		return config->motion_valid_time;
+		case PARAM_STATIONARY_VALID_TIME:	return config->stationary_valid_time;
+		case PARAM_ABSENCE_VALID_TIME:		return config->absence_valid_time;
+		case PARAM_SCENARIO:				return config->scenario;
+		case PARAM_SENSITIVITY:				return config->sensitivity;
+		case PARAM_TIME_OF_ABSENCE:			return config->time_of_absence;
+		case PARAM_UNDERLYING:				return config->underlying;
+		default:							return 0;
+	}
+}
+
+/*!
+ * @fn setConfigValue
+ * @brief writes one parameter into a configuration snapshot
+ * @param config snapshot to change
+ * @param param PARAM_ parameter
+ * @param value new value of the parameter
+ */
+void setConfigValue(RadarConfig* config, byte param, unsigned long value) {
+	switch (param) {
+		case PARAM_PRESENCE_THRESHOLD:		config->presence_threshold = value; break;
+		case PARAM_PRESENCE_RANGE:			config->presence_range = value; break;
+		case PARAM_MOTION_THRESHOLD:		config->motion_threshold = value; break;
+		case PARAM_MOTION_RANGE:			config->motion_range = value; break;
+		case PARAM_MOTION_VALID_TIME:		config->motion_valid_time = value; break;
+		case PARAM_STATIONARY_VALID_TIME:	config->stationary_valid_time = value; break;
+		case PARAM_ABSENCE_VALID_TIME:		config->absence_valid_time = value; break;
+		case PARAM_SCENARIO:				config->scenario = value; break;
+		case PARAM_SENSITIVITY:				config->sensitivity = value; break;
+		case PARAM_TIME_OF_ABSENCE:			config->time_of_absence = value; break;
+		case PARAM_UNDERLYING:				config->underlying = value; break;
+		default:							break;
+	}
 }
 
 /*!
@@ -20,73 +129,163 @@ Radar::Radar(Stream *s)
  * @brief command to get the data length of a particular control command combination
  * @param control  	control byte
  * @param command	command byte
- * @returns number of data bytes for the control command combination
+ * @returns number of data bytes for the control command combination, 0 if it is not a known command
  */
 
 unsigned int Radar::getDataLength(byte control, byte command) {
-	switch (control) {
-		case WORKING_STATUS_RANGE:
-			switch(command) {
-				case GET_MAX_ACTIVE_RANGE:
-					return 1;
-					break;
-				case GET_MAX_STATIONARY_RANGE:
-					return 1;
-					break;
-				default:
-					return 2;
-					break;
+	return commandWidth(control, command);
+}
+
+/*!
+ * @fn fillBuffer
+ * @brief drains whatever the stream has available into the receive ring buffer using
+ * 		bulk reads. Bytes belonging to a frame that is still being parsed, or to the last frame
+ * 		returned by getFrame(), are never overwritten
+ * @returns number of bytes added to the buffer
+ */
+unsigned int Radar::fillBuffer() {
+	int available = stream->available();
+	if (available <= 0) return 0;
+	unsigned int wanted = available;
+	unsigned int head = rx_head;
+	unsigned int room = RX_BUFFER_SIZE - (head - rx_tail);
+	if (wanted > room) wanted = room;					// parser is behind, the rest waits in the stream
+	unsigned int total = 0;
+	while (wanted > 0) {
+		unsigned int offset = head & RX_BUFFER_MASK;
+		unsigned int chunk = RX_BUFFER_SIZE - offset;
+		if (chunk > wanted) chunk = wanted;
+		unsigned int got = stream->readBytes((char*)&rx_buf[offset], chunk);
+		if (capture_sink != NULL && got > 0) capture_sink->capture(micros(), CAPTURE_RX, &rx_buf[offset], got);
+		head += got;
+		total += got;
+		wanted -= got;
+		if (got < chunk) break;
+	}
+	RADAR_MEMORY_BARRIER();								// bytes are in place before the parser sees them
+	rx_head = head;
+	return total;
+}
+
+/*!
+ * @fn parseByte
+ * @brief advances the receive state machine by one byte. The bytes themselves stay in the
+ * 		receive buffer, only the running checksum and counts are kept here. The declared data
+ * 		length drives the parse, frames that would not fit in an RxFrame, fail the checksum or
+ * 		have a bad trailer send the parser back to hunting for HEAD1
+ * @param c next byte from the module
+ * @returns true when the byte completes a frame
+ */
+bool Radar::parseByte(byte c) {
+	switch (rx_state) {
+		case PARSE_HEAD1:
+			if (c == HEAD1) rx_state = PARSE_HEAD2;
+			else counters.resync_bytes++;
+			return false;
+		case PARSE_HEAD2:
+			if (c == HEAD2) {
+				rx_checksum = HEAD1 + HEAD2;
+				rx_state = PARSE_CONTROL;
+			} else if (c != HEAD1) rx_state = PARSE_HEAD1;
+			return false;
+		case PARSE_CONTROL:
+			rx_checksum += c;
+			rx_state = PARSE_COMMAND;
+			return false;
+		case PARSE_COMMAND:
+			rx_checksum += c;
+			rx_state = PARSE_LENGTH_H;
+			return false;
+		case PARSE_LENGTH_H:
+			rx_checksum += c;
+			rx_length = (unsigned int)c << 8;
+			rx_state = PARSE_LENGTH_L;
+			return false;
+		case PARSE_LENGTH_L:
+			rx_checksum += c;
+			rx_length = rx_length | c;
+			if (rx_length > RxFrame::capacity - FRAME_OVERHEAD) {	// would not fit, resync
+				counters.bad_frames++;
+				rx_state = PARSE_HEAD1;
+				return false;
 			}
-		case CUSTOM:
-			switch(command) {
-				case SET_MOTION_VALID_TIME:
-					return 4;
-					break;
-				case SET_STATIONARY_VALID_TIME:
-					return 4;
-					break;
-				case SET_ABSENCE_VALID_TIME:
-					return 4;
-					break;
-				default:
-					return 1;
-					break;
+			rx_count = 0;
+			rx_state = (rx_length > 0) ? PARSE_DATA : PARSE_CHECKSUM;
+			return false;
+		case PARSE_DATA:
+			rx_checksum += c;
+			rx_count++;
+			if (rx_count == rx_length) rx_state = PARSE_CHECKSUM;
+			return false;
+		case PARSE_CHECKSUM:
+			if (c == rx_checksum) rx_state = PARSE_END1;
+			else {
+				counters.bad_checksums++;
+				rx_state = PARSE_HEAD1;
+			}
+			return false;
+		case PARSE_END1:
+			if (c == END1) rx_state = PARSE_END2;
+			else {
+				counters.bad_frames++;
+				rx_state = PARSE_HEAD1;
 			}
+			return false;
+		case PARSE_END2:
+			rx_state = PARSE_HEAD1;
+			if (c != END2) counters.bad_frames++;
+			return (c == END2);
 		default:
-			return 1;
-			break;
+			rx_state = PARSE_HEAD1;
+			return false;
 	}
 }
 
 /*!
  * @fn getFrame
- * @brief reads a frame from the radar module
- * @param frame frame structure to hold returned data and length read
- * @returns true is successful read, false if nothing to read
- */
-bool Radar::getFrame(Frame* frame) {
-	int l = 0;
-	byte c;
-	while (stream->available()) {
-		c = stream->read();
-		if (c == HEAD1) {
-			frame->msg[l] = c;
-			l++;
-			c = stream->read();
-			if (c == HEAD2) {
-				frame->msg[l] = c;
-				l++;
-				c = stream->read();
-				while (c != END2) {
-					frame->msg[l] = c;
-					l++; 
-					c = stream->read();
-				}
-				frame->l = l+1;
-				frame->msg[l] = c;
-				if (frame->msg[l-1] != END1) return false;
-				return true;
+ * @brief parses buffered bytes, refilling the receive buffer from the stream when it runs dry.
+ * 		It never waits on the stream, a partially received frame is finished on a later call.
+ * 		When a frame fails part way through, parsing restarts on the byte after its header so
+ * 		a real frame hiding inside the bad one is not lost
+ * @param frame view set to the frame in the receive buffer. Only valid until the next call,
+ * 		which is when its bytes are handed back to the producer
+ * @returns true if a complete frame was read, false if no complete frame is available yet
+ */
+bool Radar::getFrame(FrameView* frame) {
+	RADAR_MEMORY_BARRIER();								// done reading the last frame before it is freed
+	rx_tail = rx_start;
+	unsigned int head = rx_head;
+	RADAR_MEMORY_BARRIER();
+	while (true) {
+		if (rx_pos == head) {
+			if (receive_mode == RECEIVE_POLL) fillBuffer();
+			head = rx_head;
+			RADAR_MEMORY_BARRIER();							// read the bytes after their head
+			if (rx_pos == head) break;
+		}
+		byte c = rx_buf[rx_pos & RX_BUFFER_MASK];
+		byte state = rx_state;
+		rx_pos++;
+		if (parseByte(c)) {
+			unsigned int offset = rx_start & RX_BUFFER_MASK;
+			frame->l = rx_pos - rx_start;
+			if (offset + frame->l <= RX_BUFFER_SIZE) {
+				frame->msg = &rx_buf[offset];
+			} else {										// frame wraps the end of the buffer
+				unsigned int first = RX_BUFFER_SIZE - offset;
+				memcpy(rx.msg, &rx_buf[offset], first);
+				memcpy(rx.msg + first, rx_buf, frame->l - first);
+				rx.l = frame->l;
+				frame->msg = rx.msg;
 			}
+			rx_start = rx_pos;
+			return true;
+		}
+		if (rx_state == PARSE_HEAD1) {
+			if (state > PARSE_HEAD2) rx_pos = rx_start + 1;	// failed part way, rescan
+			rx_start = rx_pos;
+		} else if (state == PARSE_HEAD1 || (state == PARSE_HEAD2 && c == HEAD1)) {
+			rx_start = rx_pos - 1;							// frame starts at this HEAD1
 		}
 	}
 	frame->l = 0;
@@ -99,10 +298,10 @@ bool Radar::getFrame(Frame* frame) {
  * @param frame frame structure to be printed
  */
 
-void Radar::printFrame(Frame* frame) {
+void Radar::printFrame(const FrameView* frame) {
 	char output[4];
 	Serial.print("msg = ");
-	for (int n = 0; n < frame->l; n++) {
+	for (unsigned int n = 0; n < frame->l; n++) {
 		sprintf(output, "%02X", frame->msg[n]);
 		Serial.print(output);
 		Serial.print(' ');
@@ -119,27 +318,84 @@ void Radar::printFrame(Frame* frame) {
  * @param frame frame structure to be sent
  */
 void Radar::putFrame(Frame* frame) {
+	if (capture_sink != NULL) capture_sink->capture(micros(), CAPTURE_TX, frame->msg, frame->l);
 	stream->write(frame->msg, frame->l);
 	stream->flush();
 }
 
 /*!
  * @fn streamFrames
- * @brief gets a frame and prints it
+ * @brief gets frames for t ms and hands them to the dump sink, or prints them when no sink
+ * 		is set
+ * @param t time to stream for in ms
  */
 void Radar::streamFrames(unsigned long t) {
-	Frame frame;
+	FrameView frame;
 	unsigned long start = millis();
 	unsigned long elapsed = 0;
 	while (elapsed <= t) {
 		if (getFrame(&frame)) {
-			printFrame(&frame);
-		}
+			if (dump_sink != NULL) dump_sink->dump(millis(), &frame);
+			else printFrame(&frame);
+		} else if (dump_sink != NULL) dump_sink->drain();
+		else yield();
 		elapsed = millis() - start;
 
 	}
 }
 
+/*!
+ * @fn setCapture
+ * @brief hands every chunk of bytes read from or written to the module to a capture sink,
+ * 		with its micros() time. Unlike streamFrames() nothing is lost and the timing is kept.
+ * 		Not available in RECEIVE_PUSH mode, where the receive callback and the loop would
+ * 		write to the sink at the same time
+ * @param sink sink such as a CaptureWriter, NULL to stop capturing
+ * @returns false if a sink was given in RECEIVE_PUSH mode
+ */
+bool Radar::setCapture(RadarCaptureSink* sink) {
+	if (sink != NULL && receive_mode == RECEIVE_PUSH) return false;
+	capture_sink = sink;
+	return true;
+}
+
+/*!
+ * @fn setDump
+ * @brief hands every valid frame to a dump sink, from updateStatus() and the blocking api as
+ * 		well as streamFrames(). Sinks such as HexDump buffer the output so the stream keeps
+ * 		being read at full rate
+ * @param sink sink to dump to, NULL to stop
+ */
+void Radar::setDump(RadarDumpSink* sink) {
+	dump_sink = sink;
+}
+
+/*!
+ * @fn setReceiveMode
+ * @brief chooses who reads the stream. In RECEIVE_PUSH mode updateStatus() never reads the
+ * 		stream, a receive callback such as HardwareSerial::onReceive on the ESP32 calls
+ * 		receive() instead, so bytes leave the UART fifo however irregular the loop is
+ * @param mode RECEIVE_POLL or RECEIVE_PUSH
+ * @returns false if RECEIVE_PUSH was asked for while a capture sink is set
+ */
+bool Radar::setReceiveMode(byte mode) {
+	if (mode == RECEIVE_PUSH && capture_sink != NULL) return false;
+	receive_mode = mode;
+	return true;
+}
+
+/*!
+ * @fn receive
+ * @brief moves whatever the stream has into the receive buffer. This is the producer side of
+ * 		a single producer single consumer buffer, it only moves rx_head and the parser only
+ * 		moves rx_tail, so it can run in a receive callback while updateStatus() runs in
+ * 		the loop. Only one receive callback may call it. Call it in RECEIVE_PUSH mode only
+ * @returns number of bytes moved, the rest stays in the stream until the parser catches up
+ */
+unsigned int Radar::receive() {
+	return fillBuffer();
+}
+
 /*!
  * @fn char_to_int
  * @brief convert a 4 byte character string and  to unsigned int
@@ -190,15 +446,9 @@ bool Radar::buildFrame(Frame* frame, unsigned char control, unsigned char comman
 		frame->msg[DATA+2] = data[2];
 		frame->msg[DATA+3] = data[3];
 	} else return false;
-	unsigned char checksum = 0;
-	int cs_byte = frame->l - 3;
-	for (int i = 0; i < cs_byte; i++) {
-		checksum = checksum + frame->msg[i];
-	}
-	frame->msg[cs_byte] = checksum;
+	frame->msg[frame->l - 3] = frameChecksum(frame->msg, frame->l);
 	frame->msg[frame->l - 2] = END1;
 	frame->msg[frame->l - 1] = END2;
-	frame->msg[frame->l] = 0X00;
 
 	return true;
 }
@@ -216,16 +466,11 @@ bool Radar::buildFrame(Frame* frame, unsigned char control, unsigned char comman
  * 
  */
 
-bool Radar::validateFrame(Frame* frame, byte control, byte command, unsigned char* data, bool check_data) {
-	byte checksum = 0;
-	unsigned int cs_byte = frame->l - 3;
+bool Radar::validateFrame(const FrameView* frame, byte control, byte command, unsigned char* data, bool check_data) {
 	int data_length = frame->l - 9;
 	if (frame->msg[CONTROL] != control) return false;	// control did not match
 	if (frame->msg[COMMAND] != command) return false;	// command did not match
-	for (int i = 0; i < cs_byte; i++) {
-		checksum = checksum + frame->msg[i];
-	}
-	if (checksum != frame->msg[cs_byte]) return false;	// checksum failed
+	if (frameChecksum(frame->msg, frame->l) != frame->msg[frame->l - 3]) return false;	// checksum failed
 	if(!check_data) return true;
 	if (data_length == 1) {
 		if (frame->msg[DATA] != data [3]) return false;
@@ -244,30 +489,399 @@ bool Radar::validateFrame(Frame* frame, byte control, byte command, unsigned cha
 
 
 /*!
- * @fn setParam
- * @brief constructs a frame and sends it to the module. Then reads up to 10 following
- * 		frames to see if the correct response is received
+ * @fn trackCommand
+ * @brief records a command in the pending command table, armed for the caller to send it
+ * 		right away. In background mode it is queued for the reader task to send
  * @param control byte to hold control value
  * @param command byte to hold command specifiying parameter
- * @param data	 data to be sent
+ * @param data 4 byte data being sent
+ * @param check_data true if the reply has to echo the data sent
+ * @returns handle for the command or -1 if the table is full
+ */
+int Radar::trackCommand(byte control, byte command, unsigned char* data, bool check_data) {
+	lockTable();
+	for (int i = 0; i < MAX_PENDING; i++) {
+		PendingCommand* cmd = &pending[i];
+		if (cmd->state != CMD_FREE) continue;
+		cmd->control = control;
+		cmd->command = command;
+		cmd->check_data = check_data;
+		memcpy(cmd->data, data, 4);
+		cmd->attempts = 0;
+		cmd->corrupt = false;
+		if (table_lock != NULL) cmd->state = CMD_QUEUED;
+		else armCommand(cmd);
+		counters.commands++;
+		unlockTable();
+		return i;
+	}
+	counters.busy++;
+	unlockTable();
+	return SUBMIT_BUSY;											// too many commands in flight
+}
+
+/*!
+ * @fn tableRoom
+ * @brief returns true if the pending command table has a free slot
+ */
+bool Radar::tableRoom() {
+	lockTable();
+	bool room = false;
+	for (int i = 0; i < MAX_PENDING && !room; i++) room = (pending[i].state == CMD_FREE);
+	unlockTable();
+	return room;
+}
+
+/*!
+ * @fn submitCommand
+ * @brief builds a request, sends it and records it in the pending command table. The reply
+ * 		is matched later by the updateStatus pump
+ * @param control byte to hold control value
+ * @param command byte to hold command specifiying parameter
+ * @param data 4 byte data to be sent
+ * @param check_data true if the reply has to echo the data sent
+ * @returns handle for the command, SUBMIT_BUSY if the table is full or SUBMIT_INVALID if the
+ * 		frame could not be built
  */
-bool Radar::setParam(byte control, byte command, unsigned char* data) {									 // currently only works with single byte data
+int Radar::submitCommand(byte control, byte command, unsigned char* data, bool check_data) {
 	Frame req;
-	Frame ret;
-	unsigned int data_length = getDataLength(control, command);
-	if (buildFrame(&req, control, command, data_length, data)) {
-			unsigned long start = millis();
-			unsigned long elapsed = 0;
-			putFrame(&req);
-			while (true && elapsed < TIME_TO_WAIT) {
-				if (getFrame(&ret)) {
-					if (validateFrame(&ret, control, command, data, true)) return true;
-				}
-			elapsed = millis() - start;
-			}
-			return false;
+	if (!buildFrame(&req, control, command, getDataLength(control, command), data)) return SUBMIT_INVALID;
+	int handle = trackCommand(control, command, data, check_data);
+	if (handle >= 0 && table_lock == NULL) putFrame(&req);
+	return handle;
+}
+
+/*!
+ * @fn submitRequest
+ * @brief sends a precomputed request frame from flash and records it in the pending command table
+ * @param request RadarRequest frame
+ * @param check_data true if the reply has to echo the data sent
+ * @returns handle for the command or SUBMIT_BUSY if the table is full
+ */
+int Radar::submitRequest(const unsigned char* request, bool check_data) {
+	Frame req;
+	memcpy_P(req.msg, request, REQUEST_FRAME_SIZE);
+	req.l = REQUEST_FRAME_SIZE;
+	unsigned char data[] = {0x00, 0x00, 0x00, req.msg[DATA]};
+	int handle = trackCommand(req.msg[CONTROL], req.msg[COMMAND], data, check_data);
+	if (handle >= 0 && table_lock == NULL) putFrame(&req);
+	return handle;
+}
+
+/*!
+ * @fn matchCommand
+ * @brief matches a received frame against the pending command table. When several requests
+ * 		with the same control and command are in flight the oldest one gets the reply
+ * @param frame received frame
+ * @returns true if the frame was the reply to a pending command
+ */
+bool Radar::matchCommand(const FrameView* frame) {
+	lockTable();
+	int oldest = -1;
+	for (int i = 0; i < MAX_PENDING; i++) {
+		PendingCommand* cmd = &pending[i];
+		if (cmd->state != CMD_PENDING) continue;
+		if (cmd->control != frame->msg[CONTROL] || cmd->command != frame->msg[COMMAND]) continue;
+		if (oldest < 0 || (long)(cmd->sent - pending[oldest].sent) < 0) oldest = i;
 	}
-	return false;
+	if (oldest < 0) {
+		unlockTable();
+		return false;
+	}
+	PendingCommand* cmd = &pending[oldest];
+	if (!validateFrame(frame, cmd->control, cmd->command, cmd->data, cmd->check_data)) {
+		cmd->state = CMD_FAILED;
+		counters.failures++;
+		unlockTable();
+		return true;
+	}
+	unsigned int data_length = frame->l - 9;
+	if (data_length == 1) {
+		cmd->data[0] = 0x00;
+		cmd->data[1] = 0x00;
+		cmd->data[2] = 0x00;
+		cmd->data[3] = frame->msg[DATA];
+	} else if (data_length == 2) {
+		cmd->data[0] = 0x00;
+		cmd->data[1] = 0x00;
+		cmd->data[2] = frame->msg[DATA];
+		cmd->data[3] = frame->msg[DATA+1];
+	} else if (data_length == 4) {
+		cmd->data[0] = frame->msg[DATA];
+		cmd->data[1] = frame->msg[DATA+1];
+		cmd->data[2] = frame->msg[DATA+2];
+		cmd->data[3] = frame->msg[DATA+3];
+	} else {
+		cmd->state = CMD_FAILED;									// unexpected data length
+		counters.failures++;
+		unlockTable();
+		return true;
+	}
+	cmd->state = CMD_DONE;
+	unsigned long rtt = micros() - cmd->sent;
+	if (cmd->attempts == 1) trackRtt(cmd->control, rtt);		// a reply to a resend could be to either
+	if (counters.replies == 0 || rtt < counters.rtt_min) counters.rtt_min = rtt;
+	if (rtt > counters.rtt_max) counters.rtt_max = rtt;
+	rtt_total += rtt;
+	counters.replies++;
+	counters.rtt_avg = rtt_total / counters.replies;
+	cacheParam(cmd);
+	unlockTable();
+	return true;
+}
+
+/*!
+ * @fn cacheParam
+ * @brief keeps the configuration snapshot up to date with a successful set or get. A reset,
+ * 		a new scenario or opening another custom mode drops the values they make stale
+ * @param cmd command that just finished
+ */
+void Radar::cacheParam(const PendingCommand* cmd) {
+	if (cmd->control == SYSTEM && cmd->command == RESET) {
+		config_valid = 0;
+		return;
+	}
+	if (cmd->control == WORKING_STATUS && cmd->command == OPEN_CUSTOM) {
+		if (cmd->data[3] != config.mode) config_valid = config_valid & ~PARAM_CUSTOM_MASK;	// values of another mode
+		config.mode = cmd->data[3];
+		return;
+	}
+	if (cmd->control == WORKING_STATUS && cmd->command == SET_SCENARIO) {
+		config_valid = config_valid & ~PARAM_CUSTOM_MASK;
+	}
+	for (byte i = 0; i < PARAM_COUNT; i++) {
+		const RadarParamInfo* info = &radar_params[i];
+		if (info->control != cmd->control) continue;
+		if (info->set != cmd->command && info->get != cmd->command) continue;
+		unsigned long v = cmd->data[3];
+		if (info->width == 4) {
+			v = ((unsigned long)cmd->data[0] << 24) | ((unsigned long)cmd->data[1] << 16) |
+				((unsigned long)cmd->data[2] << 8) | cmd->data[3];
+		}
+		setConfigValue(&config, i, v);
+		config_valid = config_valid | (1 << i);
+		return;
+	}
+}
+
+/*!
+ * @fn expireCommands
+ * @brief sends pending commands whose reply timeout has passed again, up to COMMAND_RETRIES
+ * 		times, and then marks them as timed out
+ */
+void Radar::expireCommands() {
+	lockTable();
+	unsigned long now = micros();
+	for (int i = 0; i < MAX_PENDING; i++) {
+		PendingCommand* cmd = &pending[i];
+		if (cmd->state != CMD_PENDING || now - cmd->sent < cmd->timeout) continue;
+		if (counters.bad_checksums != cmd->checksums) cmd->corrupt = true;
+		if (cmd->attempts <= COMMAND_RETRIES && sendCommand(cmd)) {
+			counters.retries++;
+			continue;
+		}
+		cmd->state = CMD_TIMEOUT;
+		counters.timeouts++;
+	}
+	unlockTable();
+}
+
+/*!
+ * @fn armCommand
+ * @brief starts the reply timeout of a command that is being sent. Each resend waits twice
+ * 		as long as the one before, up to TIME_TO_WAIT
+ * @param cmd command in the pending command table
+ */
+void Radar::armCommand(PendingCommand* cmd) {
+	cmd->attempts++;
+	cmd->timeout = commandTimeout(cmd->control) << (cmd->attempts - 1);
+	if (cmd->timeout > TIME_TO_WAIT * 1000UL) cmd->timeout = TIME_TO_WAIT * 1000UL;
+	cmd->checksums = counters.bad_checksums;
+	cmd->sent = micros();
+	cmd->state = CMD_PENDING;
+}
+
+/*!
+ * @fn sendCommand
+ * @brief builds the request for a command in the table, sends it and arms its timeout
+ * @param cmd command in the pending command table
+ * @returns false if the frame could not be built
+ */
+bool Radar::sendCommand(PendingCommand* cmd) {
+	Frame req;
+	if (!buildFrame(&req, cmd->control, cmd->command, getDataLength(cmd->control, cmd->command), cmd->data)) return false;
+	putFrame(&req);
+	armCommand(cmd);
+	return true;
+}
+
+/*!
+ * @fn trackRtt
+ * @brief adds a measured round trip to the smoothed round trip and deviation of its bucket
+ * @param control control byte of the command
+ * @param rtt round trip in us
+ */
+void Radar::trackRtt(byte control, unsigned long rtt) {
+	byte b = controlBucket(control);
+	if (srtt[b] == 0) {
+		srtt[b] = rtt;
+		rttvar[b] = rtt / 2;
+		return;
+	}
+	unsigned long error = (rtt > srtt[b]) ? rtt - srtt[b] : srtt[b] - rtt;
+	rttvar[b] = rttvar[b] - rttvar[b] / 4 + error / 4;
+	srtt[b] = srtt[b] - srtt[b] / 8 + rtt / 8;
+}
+
+/*!
+ * @fn commandTimeout
+ * @brief returns how long a command is given for its first reply. It is the smoothed round
+ * 		trip of its bucket plus RTT_K deviations, RTO_INITIAL until a round trip has been
+ * 		measured, and never under RTO_MIN or over TIME_TO_WAIT
+ * @param control control byte of the command
+ * @returns timeout in us
+ */
+unsigned long Radar::commandTimeout(byte control) {
+	byte b = controlBucket(control);
+	unsigned long t = srtt[b] ? srtt[b] + RTT_K * rttvar[b] : RTO_INITIAL * 1000UL;
+	if (t < RTO_MIN * 1000UL) t = RTO_MIN * 1000UL;
+	if (t > TIME_TO_WAIT * 1000UL) t = TIME_TO_WAIT * 1000UL;
+	return t;
+}
+
+/*!
+ * @fn submitSet
+ * @brief sends a set command without waiting for the reply. The reply is matched by
+ * 		updateStatus, check on it with commandState and collect it with commandResult
+ * @param control byte to hold control value
+ * @param command byte to hold command specifiying parameter
+ * @param data 4 byte data to be sent, ordered big endian
+ * @returns handle for the command, SUBMIT_BUSY if MAX_PENDING commands are in flight or
+ * 		SUBMIT_INVALID if it is not a known set command
+ */
+int Radar::submitSet(byte control, byte command, unsigned char* data) {
+	if (commandDirection(control, command) != DIR_SET) return SUBMIT_INVALID;
+	return submitCommand(control, command, data, true);
+}
+
+/*!
+ * @fn submitGet
+ * @brief sends a get command without waiting for the reply. The reply is matched by
+ * 		updateStatus, check on it with commandState and collect it with commandResult
+ * @param control byte to hold control value
+ * @param command byte to hold command specifiying parameter
+ * @returns handle for the command, SUBMIT_BUSY if MAX_PENDING commands are in flight or
+ * 		SUBMIT_INVALID if it is not a known get command
+ */
+int Radar::submitGet(byte control, byte command) {
+	if (commandDirection(control, command) != DIR_GET) return SUBMIT_INVALID;
+	unsigned char data[] = {0x00, 0x00, 0x00, REQUEST_DATA};
+	return submitCommand(control, command, data, false);
+}
+
+/*!
+ * @fn commandState
+ * @brief returns the state of a submitted command
+ * @param handle handle returned by submitSet or submitGet
+ * @returns CMD_PENDING, CMD_DONE, CMD_FAILED, CMD_TIMEOUT or CMD_FREE for an unused handle
+ */
+byte Radar::commandState(int handle) {
+	if (handle < 0 || handle >= MAX_PENDING) return CMD_FREE;
+	lockTable();
+	byte state = pending[handle].state;
+	unlockTable();
+	return (state == CMD_QUEUED) ? CMD_PENDING : state;
+}
+
+/*!
+ * @fn commandResult
+ * @brief collects the result of a finished command and frees its handle. Does nothing while
+ * 		the command is still pending
+ * @param handle handle returned by submitSet or submitGet
+ * @param data 4 byte array to receive the returned data, may be NULL
+ * @param result receives the RESULT_ code of this command once it has finished, may be NULL
+ * @returns true if the command succeeded, false if it failed, timed out or is still pending
+ */
+bool Radar::commandResult(int handle, unsigned char* data, byte* result) {
+	if (handle < 0 || handle >= MAX_PENDING) return false;
+	lockTable();
+	PendingCommand* cmd = &pending[handle];
+	if (cmd->state == CMD_PENDING || cmd->state == CMD_QUEUED || cmd->state == CMD_FREE) {
+		unlockTable();
+		return false;
+	}
+	bool ok = (cmd->state == CMD_DONE);
+	if (ok && data != NULL) memcpy(data, cmd->data, 4);
+	if (ok) last_result = RESULT_OK;
+	else if (cmd->state == CMD_FAILED) last_result = RESULT_NACK;
+	else last_result = cmd->corrupt ? RESULT_CHECKSUM : RESULT_TIMEOUT;
+	if (result != NULL) *result = last_result;
+	cmd->state = CMD_FREE;
+	unlockTable();
+	return ok;
+}
+
+/*!
+ * @fn lastResult
+ * @brief returns why the last command collected, by a blocking call or commandResult, failed.
+ * 		In background mode another task's command may have been collected since, pass a
+ * 		result to the call instead
+ * @returns RESULT_OK, RESULT_NACK, RESULT_CHECKSUM, RESULT_TIMEOUT, RESULT_BUSY or RESULT_INVALID
+ */
+byte Radar::lastResult() {
+	lockTable();
+	byte result = last_result;
+	unlockTable();
+	return result;
+}
+
+/*!
+ * @fn cancelCommand
+ * @brief frees a command handle, a late reply is then treated like any other frame
+ * @param handle handle returned by submitSet or submitGet
+ */
+void Radar::cancelCommand(int handle) {
+	if (handle < 0 || handle >= MAX_PENDING) return;
+	lockTable();
+	pending[handle].state = CMD_FREE;
+	unlockTable();
+}
+
+/*!
+ * @fn waitCommand
+ * @brief runs the updateStatus pump until a command finishes, so status frames arriving in
+ * 		the meantime still update presence and motion. In background mode it leaves that
+ * 		to the reader task
+ * @param handle handle returned by submitCommand
+ * @param data 4 byte array to receive the returned data, may be NULL
+ * @param result receives the RESULT_ code of this command, may be NULL
+ * @returns true if the command succeeded
+ */
+bool Radar::waitCommand(int handle, unsigned char* data, byte* result) {
+	if (handle < 0) {
+		lockTable();
+		last_result = (handle == SUBMIT_INVALID) ? RESULT_INVALID : RESULT_BUSY;
+		if (result != NULL) *result = last_result;
+		unlockTable();
+		return false;
+	}
+	while (commandState(handle) == CMD_PENDING) {
+		idle();
+	}
+	return commandResult(handle, data, result);
+}
+
+/*!
+ * @fn setParam
+ * @brief constructs a frame and sends it to the module. Then waits for the reply echoing
+ * 		the data sent
+ * @param control byte to hold control value
+ * @param command byte to hold command specifiying parameter
+ * @param data	 data to be sent
+ * @param result receives the RESULT_ code of this call, may be NULL
+ */
+bool Radar::setParam(byte control, byte command, unsigned char* data, byte* result) {
+	return waitCommand(submitCommand(control, command, data, true), data, result);
 }
 
 /*!
@@ -276,341 +890,413 @@ bool Radar::setParam(byte control, byte command, unsigned char* data) {
  * @param control byte to hold control value
  * @param command byte to hold command specifiying parameter
  * @param data char array to receive the data
- * @returns returns byte value of the parameter and or -1 if request failed
+ * @param result receives the RESULT_ code of this call, may be NULL
+ * @returns true if the value was received
  */
-bool Radar::getParam(byte control, byte command, unsigned char* data) {				// currently only works with single byte data
-	Frame req;
-	Frame ret;
-
-	int data_length = getDataLength(control, command);
-	if (buildFrame(&req, control, command, data_length, data)) {
-		unsigned long start = millis();
-		unsigned long elapsed = 0;
-		putFrame(&req);
-		while (true && elapsed < TIME_TO_WAIT) {
-			if (getFrame(&ret)) {
-				if (validateFrame(&ret, control, command, data, false)) {
-					data_length = ret.l - 9;
-					if (data_length == 1 ) {
-						data[0] = 0x00;
-						data[1] = 0x00;
-						data[2] = 0x00;
-						data[3] = ret.msg[DATA];
-						return true;
-					} else if (data_length == 2) {
-						data[0] = 0x00;
-						data[1] = 0x00;
-						data[2] = ret.msg[DATA];
-						data[3] = ret.msg[DATA+1];
-						return true;
-					} else if (data_length == 4) {
-						data[0] = ret.msg[DATA];
-						data[1] = ret.msg[DATA+1];
-						data[2] = ret.msg[DATA+2];
-						data[3] = ret.msg[DATA+3];
-						return true;
-					}
-				} 
-				return false;
+bool Radar::getParam(byte control, byte command, unsigned char* data, byte* result) {
+	return waitCommand(submitCommand(control, command, data, false), data, result);
+}
 
+/*!
+ * @fn readParam
+ * @brief returns a parameter from the configuration snapshot, asking the module for it only
+ * 		if it has not been read or set yet
+ * @param param PARAM_ parameter
+ * @param result receives the RESULT_ code of this call, may be NULL
+ * @returns value of the parameter, -1 on failure
+ */
+unsigned long Radar::readParam(byte param, byte* result) {
+	if (!(PARAM_ALL_MASK & (1 << param))) {
+		if (result != NULL) *result = RESULT_INVALID;
+		return (unsigned long)-1;
+	}
+	lockTable();
+	bool known = config_valid & (1 << param);
+	unlockTable();
+	if (known && result != NULL) *result = RESULT_OK;
+	if (!known) {
+		if (!waitCommand(submitRequest(radar_params[param].request, false), NULL, result)) return (unsigned long)-1;
+	}
+	lockTable();
+	unsigned long v = configValue(&config, param);
+	unlockTable();
+	return v;
+}
+
+/*!
+ * @fn readConfig
+ * @brief reads every parameter from the module into the configuration snapshot. The gets
+ * 		are pipelined so this costs about one round trip per MAX_PENDING parameters. Gives up
+ * 		when nothing could be sent and no reply came for TIME_TO_WAIT ms, such as when other
+ * 		commands hold the whole table
+ * @returns true if every parameter was read
+ */
+bool Radar::readConfig() {
+	int handles[PARAM_COUNT];
+	unsigned int sent = 0;
+	unsigned int done = 0;
+	unsigned int read = 0;
+	unsigned long progress = millis();
+	while (done != PARAM_ALL_MASK) {
+		for (byte i = 0; i < PARAM_COUNT; i++) {
+			if ((sent & (1 << i)) || !(PARAM_ALL_MASK & (1 << i))) continue;
+			if (!tableRoom()) break;						// table full, wait for replies
+			handles[i] = submitRequest(radar_params[i].request, false);
+			if (handles[i] < 0) break;
+			sent = sent | (1 << i);
+			progress = millis();
+		}
+		idle();
+		for (byte i = 0; i < PARAM_COUNT; i++) {
+			unsigned int bit = 1 << i;
+			if (!(sent & bit) || (done & bit) || commandState(handles[i]) == CMD_PENDING) continue;
+			if (commandResult(handles[i], NULL)) read = read | bit;
+			done = done | bit;
+			progress = millis();
+		}
+		if (millis() - progress > TIME_TO_WAIT) {
+			for (byte i = 0; i < PARAM_COUNT; i++) {
+				if ((sent & (1 << i)) && !(done & (1 << i))) cancelCommand(handles[i]);
 			}
-		elapsed = millis() - start;
+			lockTable();
+			last_result = RESULT_TIMEOUT;
+			unlockTable();
+			return false;
 		}
-	return false;
 	}
+	return read == PARAM_ALL_MASK;
+}
+
+/*!
+ * @fn getConfig
+ * @brief copies the configuration snapshot without talking to the module
+ * @param c snapshot to fill in
+ * @returns true if every parameter in the snapshot is known
+ */
+bool Radar::getConfig(RadarConfig* c) {
+	lockTable();
+	*c = config;
+	bool complete = (config_valid == PARAM_ALL_MASK);
+	unlockTable();
+	return complete;
+}
+
+/*!
+ * @fn applyConfig
+ * @brief sends only the parameters that differ from the configuration snapshot, or that are
+ * 		not known yet. Custom mode parameters are sent through a RadarProfile using desired->mode,
+ * 		all of them when desired->mode is not the cached mode
+ * @param desired configuration the module should end up with
+ * @returns true if every parameter that was sent succeeded
+ */
+bool Radar::applyConfig(const RadarConfig* desired) {
+	RadarProfile profile(desired->mode);
+	bool changed = false;
+	lockTable();
+	unsigned int known = config_valid;
+	if (desired->mode != config.mode) known = known & ~PARAM_CUSTOM_MASK;	// cached values are another mode's
+	for (byte i = 0; i < PARAM_COUNT; i++) {
+		if (!(PARAM_ALL_MASK & (1 << i))) continue;
+		unsigned long v = configValue(desired, i);
+		if ((known & (1 << i)) && configValue(&config, i) == v) continue;
+		profile.set(i, v);
+		changed = true;
+	}
+	unlockTable();
+	if (!changed) return true;
+	return profile.apply(this);
+}
+
+/*!
+ * @fn invalidateConfig
+ * @brief forgets the configuration snapshot so the next gets go to the module
+ */
+void Radar::invalidateConfig() {
+	lockTable();
+	config_valid = 0;
+	unlockTable();
 }
 
 /*!
  * @fn resetRadar
  * @brief resets the radar module 
  * 		note that this does not factory reset all of the settings.
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns
  */
-bool Radar::resetRadar() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	return setParam(SYSTEM, RESET, data);
+bool Radar::resetRadar(byte* result) {
+	return waitCommand(submitRequest(RadarRequest<SYSTEM, RESET>::frame, true), NULL, result);
 }
 
+#ifndef RADAR_NO_SCENARIOS
 /*!
  * @fn setSenario
  * @brief sets the scenario used by the module
  * 		note that this does not factory reset all of the settings.
  * @param scenario  the scenario to be used 
  * 					can be LIVING_ROOM, AREA_DETECTION, BEDROOM, or BATHROOM
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true on success, false if failed
  */
-bool Radar::setScenario(byte scenario) {
+bool Radar::setScenario(byte scenario, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, scenario};
-	return setParam(WORKING_STATUS, SET_SCENARIO, data);
+	return setParam(WORKING_STATUS, SET_SCENARIO, data, result);
 }
 
 /*!
  * @fn getScanario
  * @brief gets the current scenario value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns byte value on success, -1 on failure
  */
-byte Radar::getScenario() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(WORKING_STATUS, GET_SCENARIO, data)) {
-		return data[3];
-	}
+byte Radar::getScenario(byte* result) {
+	return (byte)readParam(PARAM_SCENARIO, result);
 }
 
 /*!
  * @fn setSensitvity
  * @brief sets the sensitivity used by the module
  * 		can be 1-3
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true on success, false if failed
  */
-bool Radar::setSensitivity(byte s) {
+bool Radar::setSensitivity(byte s, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, s};
-	return setParam(WORKING_STATUS, SET_SENSITIVITY, data);
+	return setParam(WORKING_STATUS, SET_SENSITIVITY, data, result);
 }
 
 /*!
  * @fn getSensitivity
  * @brief gets the current sensitivity value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns unsigned int value on success, -1 on failure
  */
-byte Radar::getSensitivity() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(WORKING_STATUS, GET_SENSITIVITY, data)) {
-		return data[3];
-	}
+byte Radar::getSensitivity(byte* result) {
+	return (byte)readParam(PARAM_SENSITIVITY, result);
 }
 
 /*!
  * @fn timeOfAbsence
  * @brief set the time to wait before absence is reported
  * @param unsigned int value between 0 and 08
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setTimeOfAbsence(byte t) {
+bool Radar::setTimeOfAbsence(byte t, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, t};
-	return setParam(HUMAN_STATUS, SET_TIME_OF_ABSENCE, data);
+	return setParam(HUMAN_STATUS, SET_TIME_OF_ABSENCE, data, result);
 }
 
 /*!
  * @fn getTimeOfAbsence
  * @brief gets the current time before absence is reported value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns unsigned int value on success, -1 on failure
  */
-byte Radar::getTimeOfAbsence() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(HUMAN_STATUS, GET_TIME_OF_ABSENCE, data)) {
-		return data[3];
-	}
+byte Radar::getTimeOfAbsence(byte* result) {
+	return (byte)readParam(PARAM_TIME_OF_ABSENCE, result);
 }
+#endif
 
 /*!
  * @fn openCustomMode
  * @brief opens custom mode to allow more control of module settings
  * @param mode unsigned int value 1-4
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true if success, false if failed
  */
-bool Radar::openCustomMode(byte mode) {
+bool Radar::openCustomMode(byte mode, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, mode};
-	return setParam(WORKING_STATUS, OPEN_CUSTOM, data);
+	return setParam(WORKING_STATUS, OPEN_CUSTOM, data, result);
 }
 
 /*!
  * @fn closeCustomMode
  * @brief closes custom mode and saves values to module
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true if success, false if failed
  */
-bool Radar::exitCustomMode() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	return setParam(WORKING_STATUS, EXIT_CUSTOM, data);
+bool Radar::exitCustomMode(byte* result) {
+	return waitCommand(submitRequest(RadarRequest<WORKING_STATUS, EXIT_CUSTOM>::frame, true), NULL, result);
 }
 
 /*!
  * @fn setPresenceThreshold
  * @brief set presence threshold for the current custom mode
  * @param unsigned int value between 0 and 250
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setPresenceThreshold(byte threshold) {
+bool Radar::setPresenceThreshold(byte threshold, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, threshold};
-	return setParam(CUSTOM, SET_PRESENCE_THRESHOLD, data);
+	return setParam(CUSTOM, SET_PRESENCE_THRESHOLD, data, result);
 }
 
 /*!
  * @fn getPresenceThreshold
  * @brief gets the current presence threshold value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns unsigned int value on success, -1 on failure
  */
-byte Radar::getPresenceThreshold() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_PRESENCE_THRESHOLD, data)) {
-		return data[3];
-	}
+byte Radar::getPresenceThreshold(byte* result) {
+	return (byte)readParam(PARAM_PRESENCE_THRESHOLD, result);
 }
 
 /*!
  * @fn setPresenceRange
  * @brief set presence range for the current custom mode
  * @param unsigned int values from 0 (0m) to 0A (5m) are valid
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setPresenceRange(byte range) {
+bool Radar::setPresenceRange(byte range, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, range};
-	return setParam(CUSTOM, SET_PRESENCE_RANGE, data);
+	return setParam(CUSTOM, SET_PRESENCE_RANGE, data, result);
 }
 
 /*!
  * @fn getPresenceRange
  * @brief gets the current presence range value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns values from 0 (0m) to 0A (5m) are valid, -1 on failure values from 0 (0m) to 0A (5m) are valid
  */
-byte Radar::getPresenceRange() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_PRESENCE_RANGE, data)) {
-		return data[3];
-	}
+byte Radar::getPresenceRange(byte* result) {
+	return (byte)readParam(PARAM_PRESENCE_RANGE, result);
 }
 
 /*!
  * @fn setMotionThreshold
  * @brief set motion threshold for the current custom mode
  * @param unsigned int value between 0 and 250
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setMotionThreshold(byte threshold){
+bool Radar::setMotionThreshold(byte threshold, byte* result){
 	unsigned char data[] = {0x00, 0x00, 0x00, threshold};
-	return setParam(CUSTOM, SET_MOTION_THRESHOLD, data);
+	return setParam(CUSTOM, SET_MOTION_THRESHOLD, data, result);
 }
 
 /*!
  * @fn getMotionThreshold
  * @brief gets the current motion threshold value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns unsigned int value on success, -1 on failure
  */
-byte Radar::getMotionThreshold() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_MOTION_THRESHOLD, data)) {
-		return data[3];
-	}
+byte Radar::getMotionThreshold(byte* result) {
+	return (byte)readParam(PARAM_MOTION_THRESHOLD, result);
 }
 
 /*!
  * @fn setMotionRange
  * @brief set motion range for the current custom mode
  * @param unsigned int values from 0 (0m) to 0A (5m) are valid
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setMotionRange(byte range) {
+bool Radar::setMotionRange(byte range, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, range};
-	return setParam(CUSTOM, SET_MOTION_RANGE, data);
+	return setParam(CUSTOM, SET_MOTION_RANGE, data, result);
 }
 
 /*!
  * @fn getMotionRange
  * @brief gets the current motion range value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns values from 0 (0m) to 0A (5m) are valid, -1 on failure values from 0 (0m) to 0A (5m) are valid
  */
-byte Radar::getMotionRange() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_MOTION_RANGE, data)) {
-		return data[3];
-	}
+byte Radar::getMotionRange(byte* result) {
+	return (byte)readParam(PARAM_MOTION_RANGE, result);
 }
 
 /*!
  * @fn setStationaryValidTime
  * @brief set presence range for the current custom mode
  * @param unsigned int values in ms
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setStationaryValidTime(unsigned int t) {
+bool Radar::setStationaryValidTime(unsigned int t, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
 	int_to_char(data, t);
-	return setParam(CUSTOM, SET_STATIONARY_VALID_TIME, data);
+	return setParam(CUSTOM, SET_STATIONARY_VALID_TIME, data, result);
 }
 
 /*!
  * @fn getStationaryValidTime
  * @brief gets the current stationary valid time value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns values in ms -1 on failure 
  */
-unsigned int Radar::getStationaryValidTime() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_STATIONARY_VALID_TIME, data)) {
-		int i = char_to_int(data);
-		return i;
-	}
+unsigned int Radar::getStationaryValidTime(byte* result) {
+	return (unsigned int)readParam(PARAM_STATIONARY_VALID_TIME, result);
 }
 
 /*!
  * @fn setMotionValidTime
  * @brief set presence range for the current custom mode
  * @param unsigned int values in ms
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setMotionValidTime(unsigned int t) {
+bool Radar::setMotionValidTime(unsigned int t, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
 	int_to_char(data, t);
-	return (setParam(CUSTOM, SET_MOTION_VALID_TIME, data));
+	return (setParam(CUSTOM, SET_MOTION_VALID_TIME, data, result));
 }
 
 /*!
  * @fn getMotionValidTime
  * @brief gets the current stationary valid time value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns values in ms -1 on failure 
  */
-unsigned int Radar::getMotionValidTime() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_MOTION_VALID_TIME, data)) {
-		int i = char_to_int(data);
-		return i;
-	}
+unsigned int Radar::getMotionValidTime(byte* result) {
+	return (unsigned int)readParam(PARAM_MOTION_VALID_TIME, result);
 }
 
 /*!
  * @fn setAbsenceValidTime
  * @brief set absence valid time for the current custom mode
  * @param unsigned int values in ms
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns true for success, false for failed
  */
-bool Radar::setAbsenceValidTime(unsigned int t) {
+bool Radar::setAbsenceValidTime(unsigned int t, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
 	int_to_char(data, t);
-	return (setParam(CUSTOM, SET_ABSENCE_VALID_TIME, data));
+	return (setParam(CUSTOM, SET_ABSENCE_VALID_TIME, data, result));
 }
 
 /*!
  * @fn getAbsenceValidTime
  * @brief gets the current absence valid time value
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns values in ms -1 on failure 
  */
-unsigned int Radar::getAbsenceValidTime() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(CUSTOM, GET_ABSENCE_VALID_TIME, data)) {
-		int i = char_to_int(data);
-		return i;
-	}
+unsigned int Radar::getAbsenceValidTime(byte* result) {
+	return (unsigned int)readParam(PARAM_ABSENCE_VALID_TIME, result);
 }
 
 /*!
  * @fn setUnderlying
  * @brief turns on an off the automatic reporting of underlying data
  * @param onoff byte value of 0 or 1 turning off or on the underlying data
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns bool true if successful false if failed
  */
-bool Radar::setUnderlying(byte onoff) {
+bool Radar::setUnderlying(byte onoff, byte* result) {
 	unsigned char data[] = {0x00, 0x00, 0x00, onoff};
-	return setParam(UNDERLYING, SET_UNDERLYING, data);
+	return setParam(UNDERLYING, SET_UNDERLYING, data, result);
 }
 
 /*!
  * @fn getUnderlying
  * @brief  returns byte indicating current  status of the underlying data switch
+ * @param result receives the RESULT_ code of this call, may be NULL
  * @returns byte value 0 or 1
-*/
-byte Radar::getUnderlying() {
-	unsigned char data[] = {0x00, 0x00, 0x00, 0x0F};
-	if (getParam(UNDERLYING, GET_UNDERLYING, data)) {
-		return data[3];
-	}
+ */
+byte Radar::getUnderlying(byte* result) {
+	return (byte)readParam(PARAM_UNDERLYING, result);
 }
 
 /*!
@@ -632,38 +1318,672 @@ bool Radar::isMoving() {
 	return false;
 }
 
+/*!
+ * @fn onEvent
+ * @brief registers a function to be called on every presence or motion transition, so the
+ * 		application does not have to poll isPresent() and isMoving()
+ * @param callback function to call, NULL to stop events
+ * @param context passed back to the callback untouched
+ */
+void Radar::onEvent(RadarEventCallback callback, void* context) {
+	event_callback = callback;
+	event_context = context;
+}
+
+/*!
+ * @fn setHistory
+ * @brief attaches a history that records every presence and motion transition
+ * @param h history to record into, NULL to stop recording
+ */
+void Radar::setHistory(RadarHistory* h) {
+	history = h;
+}
+
+/*!
+ * @fn setAmplitudeStats
+ * @brief attaches statistics that every motion amplitude report is added to. An
+ * 		EVENT_ACTIVITY event is emitted when the activity level changes
+ * @param a statistics to update, NULL to stop
+ */
+void Radar::setAmplitudeStats(RadarAmplitude* a) {
+	amplitude_stats = a;
+}
+
+/*!
+ * @fn setPublisher
+ * @brief attaches a publisher that every event is reported to. updateStatus() polls it, so
+ * 		coalesced changes are published from there
+ * @param p publisher, NULL to stop
+ */
+void Radar::setPublisher(RadarPublisher* p) {
+	publisher = p;
+}
+
+/*!
+ * @fn setZones
+ * @brief attaches zones that every underlying data and position report is placed in. The zones
+ * 		are vacated when the module reports absence, and updateStatus() vacates the ones the
+ * 		target has left
+ * @param z zones, NULL to stop
+ */
+void Radar::setZones(RadarZones* z) {
+	zones = z;
+}
+
+/*!
+ * @fn emitEvent
+ * @brief stamps a transition, records it in the history and hands it to the publisher and
+ * 		the registered callback
+ * @param type EVENT_PRESENCE, EVENT_MOTION, EVENT_ACTIVITY or EVENT_LINK
+ * @param previous state before the report
+ * @param current state reported
+ */
+void Radar::emitEvent(byte type, byte previous, byte current) {
+	unsigned long t = millis();
+	if (history != NULL && (type == EVENT_PRESENCE || type == EVENT_MOTION)) history->record(t, presence, motion);
+	if (event_callback == NULL && event_queue == NULL && publisher == NULL) return;
+	RadarEvent event;
+	event.t = t;
+	event.type = type;
+	event.previous = previous;
+	event.current = current;
+	if (event_queue != NULL) event_queue->push(event);
+	if (publisher != NULL) publisher->report(&event);
+	if (event_callback != NULL) event_callback(&event, event_context);
+}
+
+/*!
+ * @fn nextSample
+ * @brief claims the next slot in the sample buffer. When the application has not kept up
+ * 		the oldest sample is dropped
+ * @param type SAMPLE_ type of the new sample
+ * @returns sample to fill in, stamped and with every field cleared
+ */
+RadarSample* Radar::nextSample(byte type) {
+	RadarSample* sample = &decoded;
+	if (sample_queue == NULL) {
+		if (sample_head - sample_tail >= SAMPLE_BUFFER_SIZE) {			// full, drop oldest
+			sample_tail++;
+			counters.overruns++;
+		}
+		sample = &samples[sample_head % SAMPLE_BUFFER_SIZE];
+		sample_head++;
+	}
+	memset(sample, 0, sizeof(RadarSample));
+	sample->t = millis();
+	sample->type = type;
+	return sample;
+}
+
+/*!
+ * @fn decodeFrame
+ * @brief decodes underlying data, motion amplitude and position reports into the sample buffer,
+ * 		feeds amplitude reports to the attached statistics and places targets in the zones
+ * @param frame received frame
+ * @returns true if the frame was decoded into a sample
+ */
+bool Radar::decodeFrame(const FrameView* frame) {
+	unsigned int data_length = frame->l - 9;
+	const unsigned char* data = frame->msg + DATA;
+	RadarSample* sample;
+	switch (frame->msg[CONTROL]) {
+		case HUMAN_STATUS:
+			switch (frame->msg[COMMAND]) {
+				case AMPLITUDE_DATA:
+				case GET_MOTION_AMP_DATA:
+					if (data_length < 1) return false;
+					sample = nextSample(SAMPLE_AMPLITUDE);
+					sample->amplitude = data[0];
+					if (amplitude_stats != NULL) {
+						byte previous = amplitude_stats->level();
+						if (amplitude_stats->add(data[0])) emitEvent(EVENT_ACTIVITY, previous, amplitude_stats->level());
+					}
+					return true;
+				case POSITION_EVENT:
+				case GET_POSITIONB_EVENT:
+					if (data_length < 1) return false;
+					sample = nextSample(SAMPLE_POSITION);
+					sample->position = data[0];
+					if (zones != NULL) zones->add(sample);
+					return true;
+				default:
+					return false;
+			}
+		case UNDERLYING:
+			if (frame->msg[COMMAND] != UNDERLYING_DATA || data_length < UNDERLYING_DATA_LENGTH) return false;
+			sample = nextSample(SAMPLE_UNDERLYING);
+			sample->presence_energy = data[0];
+			sample->presence_gate = data[1];
+			sample->motion_energy = data[2];
+			sample->motion_gate = data[3];
+			sample->speed = data[4];
+			if (zones != NULL) zones->add(sample);
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*!
+ * @fn samplesAvailable
+ * @brief returns the number of decoded samples waiting to be read. In background mode only the
+ * 		reader task may call it, other tasks get the samples through setSampleQueue()
+ */
+unsigned int Radar::samplesAvailable() {
+	return sample_head - sample_tail;
+}
+
+/*!
+ * @fn readSamples
+ * @brief drains decoded samples, oldest first. In background mode only the reader task may
+ * 		call it, other tasks get the samples through setSampleQueue()
+ * @param out array to receive the samples
+ * @param max size of out
+ * @returns number of samples copied to out
+ */
+unsigned int Radar::readSamples(RadarSample* out, unsigned int max) {
+	unsigned int n = 0;
+	while (n < max && sample_tail != sample_head) {
+		out[n] = samples[sample_tail % SAMPLE_BUFFER_SIZE];
+		sample_tail++;
+		n++;
+	}
+	return n;
+}
+
+/*!
+ * @fn dispatchFrame
+ * @brief hands a received frame to the pending command table, or to the presence and
+ * 		motion state and the sample decoders if it is not a reply
+ * @param frame received frame
+ */
+void Radar::dispatchFrame(const FrameView* frame) {
+	last_seen = millis();
+	if (dump_sink != NULL) dump_sink->dump(last_seen, frame);
+	countFrame(frame->msg[CONTROL]);
+	if (matchCommand(frame)) return;
+	bool handled = decodeFrame(frame);
+	if (handled) {
+		trackCadence(&reports, last_seen);
+		if (sample_queue != NULL) sample_queue->push(decoded);
+	}
+	switch (frame->msg[CONTROL]) {
+		case SYSTEM:
+			if (frame->msg[COMMAND] == HEARTBEAT) {
+				handled = true;
+				trackCadence(&heartbeats, last_seen);
+			}
+			break;
+		case HUMAN_STATUS:
+			switch (frame->msg[COMMAND]) {
+				case PRESENCE:
+					handled = true;
+					if (frame->msg[DATA] != presence) {
+						byte previous = presence;
+						presence = frame->msg[DATA];
+						status_changed = true;
+						if (zones != NULL && !presence) zones->vacate();
+						emitEvent(EVENT_PRESENCE, previous, frame->msg[DATA]);
+					}
+					break;
+				case MOTION:
+					handled = true;
+					if (frame->msg[DATA] != motion) {
+						byte previous = motion;
+						motion = frame->msg[DATA];
+						status_changed = true;
+						emitEvent(EVENT_MOTION, previous, motion);
+					}
+					break;
+				default:
+					break;
+			}
+			break;
+		default:
+			break;
+	}
+	if (!handled) counters.ignored++;
+}
+
+/*!
+ * @fn pump
+ * @brief processes every frame available from the module, drains the dump sink and times out
+ * 		stale commands
+ */
+void Radar::pump() {
+	FrameView f;
+	if (table_lock != NULL) sendQueued();
+	while (getFrame(&f)) {
+		dispatchFrame(&f);
+	}
+	if (dump_sink != NULL) dump_sink->drain();
+	expireCommands();
+	if (table_lock != NULL) {										// snapshot for the other tasks
+		lockTable();
+		shared_counters = counters;
+		unlockTable();
+	}
+}
+
 /*!
  * @fn updateStatus
- * @brief goes in loop to  get frames abd update presnec snd motion status. It is non blocking and
- * passes through if no frames are available.
- * @returns true for new data, false for no change
+ * @brief processes available frames to update presence and motion status and to match replies
+ * 		to submitted commands, and runs the link watchdog. It is non blocking and passes through
+ * 		if no complete frame is available yet.
+ * @returns true if presence or motion changed since the last call, false for no change
  */
 
 bool Radar::updateStatus() {
-	Frame f;
-	bool changed = false;
-	if (getFrame(&f)) {
-		switch (f.msg[CONTROL]) {
-			case HUMAN_STATUS:
-				switch (f.msg[COMMAND]) {
-					case PRESENCE:
-						if (f.msg[DATA] != presence) {
-							presence = f.msg[DATA];
-							changed = true;
-						}
-						break;
-					case MOTION:
-						if (f.msg[DATA] != motion) {
-							motion = f.msg[DATA];
-							changed = true;
-						}
-						break;
-					default:
-						changed = false;
-						break;
-
-				}
-		}
+	pump();
+	watchLink();
+	if (publisher != NULL) publisher->poll(millis());
+	if (zones != NULL) zones->update(millis());
+	bool changed = status_changed;
+	status_changed = false;
 	return changed;
+}
+
+/*!
+ * @fn setHeartbeatTimeout
+ * @brief turns on the link watchdog. The link is degraded when nothing has been heard from the
+ * 		module for t ms, and lost after 2 * t ms. The module sends a heartbeat every few seconds
+ * @param t timeout in ms, 0 turns the watchdog off
+ */
+void Radar::setHeartbeatTimeout(unsigned long t) {
+	link_timeout = t;
+	last_seen = millis();
+	recovery = RECOVER_IDLE;
+	if (recovery_handle >= 0) cancelCommand(recovery_handle);
+	recovery_handle = -1;
+	setLink(LINK_HEALTHY);
+}
+
+/*!
+ * @fn setRecoveryProfile
+ * @brief sets the profile that is reapplied after the module has been reset by the watchdog
+ * @param p profile to reapply, NULL to only reset
+ */
+void Radar::setRecoveryProfile(RadarProfile* p) {
+	recovery_profile = p;
+}
+
+/*!
+ * @fn linkState
+ * @brief returns LINK_HEALTHY, LINK_DEGRADED or LINK_LOST
+ */
+byte Radar::linkState() {
+	return link;
+}
+
+/*!
+ * @fn recoveryState
+ * @brief returns one of the RECOVER_ states
+ */
+byte Radar::recoveryState() {
+	return recovery;
+}
+
+/*!
+ * @fn lastSeen
+ * @brief returns the millis() time of the last heartbeat or other frame from the module
+ */
+unsigned long Radar::lastSeen() {
+	return last_seen;
+}
+
+/*!
+ * @fn resync
+ * @brief drops any partly received frame and the unparsed bytes, so parsing starts again on
+ * 		the next header
+ */
+void Radar::resync() {
+	rx_pos = rx_head;
+	rx_start = rx_head;
+	rx_tail = rx_head;
+	rx_state = PARSE_HEAD1;
+}
+
+/*!
+ * @fn setLink
+ * @brief changes the link state, emitting an EVENT_LINK event when it changes
+ * @param state LINK_ state
+ */
+void Radar::setLink(byte state) {
+	if (state == link) return;
+	byte previous = link;
+	link = state;
+	emitEvent(EVENT_LINK, previous, state);
+}
+
+/*!
+ * @fn watchLink
+ * @brief link watchdog, run from updateStatus(). A silent link is first resynced. If it stays
+ * 		silent the module is reset, and once it talks again the recovery profile is reapplied.
+ * 		Every step is a submitted command or a profile poll, so it never blocks
+ */
+void Radar::watchLink() {
+	if (link_timeout == 0) return;
+	unsigned long now = millis();
+	unsigned long silent = now - last_seen;
+	switch (recovery) {
+		case RECOVER_IDLE:
+			if (silent > 2 * link_timeout) {
+				setLink(LINK_LOST);
+				recovery = RECOVER_RESET;
+			} else if (silent > link_timeout) {
+				if (link == LINK_HEALTHY) resync();
+				setLink(LINK_DEGRADED);
+			} else setLink(LINK_HEALTHY);
+			return;
+		case RECOVER_RESET:
+			if (recovery_handle < 0) {
+				recovery_handle = submitRequest(RadarRequest<SYSTEM, RESET>::frame, true);
+				return;										// table full, try again on the next call
+			}
+			if (commandState(recovery_handle) == CMD_PENDING) return;
+			if (commandResult(recovery_handle, NULL)) {
+				recovery = RECOVER_RESTART;
+				recovery_started = now;
+			}												// otherwise send it again
+			recovery_handle = -1;
+			return;
+		case RECOVER_RESTART:
+			if ((long)(last_seen - recovery_started) > 0) {
+				if (recovery_profile != NULL && recovery_profile->begin(this)) recovery = RECOVER_CONFIG;
+				else recovery = RECOVER_IDLE;
+			} else if (now - recovery_started > 2 * link_timeout) recovery = RECOVER_RESET;
+			return;
+		case RECOVER_CONFIG:
+			if (recovery_profile->poll()) recovery = RECOVER_IDLE;
+			return;
+		default:
+			recovery = RECOVER_IDLE;
+			return;
+	}
+}
+
+/*!
+ * @fn controlBucket
+ * @brief maps a control byte to its COUNT_ bucket
+ * @param control control byte
+ * @returns one of the COUNT_ buckets
+ */
+byte Radar::controlBucket(byte control) {
+	switch (control) {
+		case SYSTEM:				return COUNT_SYSTEM;
+		case WORKING_STATUS:		return COUNT_WORKING_STATUS;
+		case WORKING_STATUS_RANGE:	return COUNT_RANGE;
+		case CUSTOM:				return COUNT_CUSTOM;
+		case HUMAN_STATUS:			return COUNT_HUMAN_STATUS;
+		default:					return COUNT_OTHER;
+	}
+}
+
+/*!
+ * @fn countFrame
+ * @brief counts a valid frame in the bucket for its control byte
+ * @param control control byte of the frame
+ */
+void Radar::countFrame(byte control) {
+	counters.frames[controlBucket(control)]++;
+}
+
+/*!
+ * @fn getCounters
+ * @brief copies a snapshot of the link counters. In background mode the reader task takes
+ * 		the snapshot after each pass, so it may be called from any task
+ * @param c receives the counters
+ */
+void Radar::getCounters(RadarCounters* c) {
+	lockTable();
+	if (table_lock != NULL) memcpy(c, &shared_counters, sizeof(RadarCounters));
+	else memcpy(c, &counters, sizeof(RadarCounters));
+	unlockTable();
+}
+
+/*!
+ * @fn resetCounters
+ * @brief sets every link counter back to 0
+ */
+void Radar::resetCounters() {
+	lockTable();
+	memset(&counters, 0, sizeof(RadarCounters));
+	memset(&shared_counters, 0, sizeof(RadarCounters));
+	rtt_total = 0;
+	unlockTable();
+}
+
+/*!
+ * @fn setBackground
+ * @brief puts the radar in background mode, for a reader task that calls updateStatus() in a
+ * 		loop while other tasks use the command api. Commands are then queued and sent by the
+ * 		reader task, so only it touches the stream, and blocking calls wait on the reader
+ * 		instead of pumping. The lock guards the command table and the configuration snapshot
+ * @param lock lock shared by the tasks, NULL to go back to single task use
+ */
+void Radar::setBackground(RadarLock* lock) {
+	if (lock == NULL && table_lock != NULL) sendQueued();	// nothing may be left queued
+	shared_counters = counters;
+	table_lock = lock;
+}
+
+/*!
+ * @fn setEventQueue
+ * @brief hands every event to a queue as well as the callback, so a task other than the one
+ * 		calling updateStatus() can consume them. Events are dropped when the queue is full
+ * @param q queue to push to, NULL to stop
+ */
+void Radar::setEventQueue(RadarQueue<RadarEvent>* q) {
+	event_queue = q;
+}
+
+/*!
+ * @fn setSampleQueue
+ * @brief sends decoded samples to a queue instead of the sample buffer, so a task other than
+ * 		the one calling updateStatus() can consume them. Samples are dropped when it is full
+ * @param q queue to push to, NULL to go back to the sample buffer
+ */
+void Radar::setSampleQueue(RadarQueue<RadarSample>* q) {
+	sample_queue = q;
+}
+
+/*!
+ * @fn lockTable
+ * @brief takes the background mode lock, does nothing in single task use
+ */
+void Radar::lockTable() {
+	if (table_lock != NULL) table_lock->lock();
+}
+
+/*!
+ * @fn unlockTable
+ * @brief releases the background mode lock
+ */
+void Radar::unlockTable() {
+	if (table_lock != NULL) table_lock->unlock();
+}
+
+/*!
+ * @fn sendQueued
+ * @brief sends the commands queued by other tasks, from the reader task
+ */
+void Radar::sendQueued() {
+	lockTable();
+	for (int i = 0; i < MAX_PENDING; i++) {
+		PendingCommand* cmd = &pending[i];
+		if (cmd->state != CMD_QUEUED) continue;
+		if (!sendCommand(cmd)) cmd->state = CMD_FAILED;
+	}
+	unlockTable();
+}
+
+/*!
+ * @fn idle
+ * @brief what a blocking call does while it waits. It pumps the stream itself and then
+ * 		sleeps until sleepUntil() if a sleep function is set, or yields. In background mode
+ * 		it only yields to the reader task
+ */
+void Radar::idle() {
+	if (table_lock != NULL) {
+		yield();
+		return;
+	}
+	pump();
+	if (sleep_callback == NULL) {
+		yield();
+		return;
+	}
+	unsigned long ms = sleepUntil() - millis();
+	if ((long)ms > 0) sleep_callback(ms, sleep_context);
+}
+
+/*!
+ * @fn setBaudRate
+ * @brief sets the uart speed the module is run at, used to predict when the rest of a frame
+ * 		or a reply is due
+ * @param baud bits per second, RADAR_BAUD unless the module has been reconfigured
+ */
+void Radar::setBaudRate(unsigned long baud) {
+	if (baud > 0) byte_time = 10000000UL / baud;		// start, 8 data and stop bits
+}
+
+/*!
+ * @fn setLatencyBound
+ * @brief sets the longest sleepUntil() will let a presence or motion report sit in the uart
+ * 		before it is processed
+ * @param ms latency bound, PRESENCE_LATENCY by default
+ */
+void Radar::setLatencyBound(unsigned long ms) {
+	latency_bound = ms;
+}
+
+/*!
+ * @fn onSleep
+ * @brief registers a function that blocking set / get calls sleep in between polls of the
+ * 		stream, instead of spinning on it
+ * @param sleep function to call with the ms until sleepUntil(), NULL to spin
+ * @param context passed back to the function untouched
+ */
+void Radar::onSleep(RadarSleepCallback sleep, void* context) {
+	sleep_callback = sleep;
+	sleep_context = context;
+}
+
+/*!
+ * @fn heartbeatPeriod
+ * @brief returns the learned time between heartbeats in ms, 0 until two have been received
+ */
+unsigned long Radar::heartbeatPeriod() {
+	return heartbeats.period;
+}
+
+/*!
+ * @fn reportPeriod
+ * @brief returns the learned time between decoded reports in ms, 0 until two have been received
+ */
+unsigned long Radar::reportPeriod() {
+	return reports.period;
+}
+
+/*!
+ * @fn trackCadence
+ * @brief adds a received frame to a learned cadence, the period is a moving average. An
+ * 		interval under half or over twice the period means the module went quiet or changed
+ * 		pace, it replaces the average
+ * @param cadence heartbeats or reports
+ * @param now millis() when the frame was received
+ */
+void Radar::trackCadence(RadarCadence* cadence, unsigned long now) {
+	if (cadence->seen) {
+		unsigned long interval = now - cadence->last;
+		if (interval > 2 * cadence->period || 2 * interval < cadence->period) cadence->period = interval;
+		else cadence->period = cadence->period - cadence->period / 4 + interval / 4;
+	}
+	cadence->last = now;
+	cadence->seen = true;
+}
+
+/*!
+ * @fn frameTime
+ * @brief time some bytes take on the wire at the module baud rate
+ * @param bytes number of bytes
+ * @returns time in ms, rounded up
+ */
+unsigned long Radar::frameTime(unsigned int bytes) {
+	return (bytes * byte_time + 999) / 1000;
+}
+
+/*!
+ * @fn sleepUntil
+ * @brief works out how long the application can sleep before updateStatus() has work to do.
+ * 		That is right away while bytes are waiting, otherwise the earliest of the end of a
+ * 		frame that is partly received, the reply or the resend of a command in flight, the
+ * 		next heartbeat or report from the learned cadences, the next change the publisher holds
+ * 		back and the next watchdog step. It is never later than the latency bound, as presence
+ * 		and motion reports cannot be predicted
+ * @returns millis() time to sleep until, the current time when there is no time to sleep
+ */
+unsigned long Radar::sleepUntil() {
+	unsigned long now = millis();
+	if (rx_pos != rx_head) return now;								// bytes waiting on the parser
+	if (receive_mode == RECEIVE_POLL && stream->available() > 0) return now;
+	unsigned long until = now + latency_bound;
+	unsigned long t;
+	if (rx_state != PARSE_HEAD1) {									// rest of the frame is on the wire
+		unsigned int left;
+		if (rx_state < PARSE_DATA) left = FRAME_OVERHEAD + 1 - rx_state;	// assume one data byte
+		else if (rx_state == PARSE_DATA) left = rx_length - rx_count + 3;
+		else left = PARSE_END2 + 1 - rx_state;
+		t = now + frameTime(left);
+		if ((long)(t - until) < 0) until = t;
+	}
+	unsigned long now_us = micros();
+	lockTable();
+	for (int i = 0; i < MAX_PENDING; i++) {
+		PendingCommand* cmd = &pending[i];
+		if (cmd->state == CMD_QUEUED) {
+			unlockTable();
+			return now;
+		}
+		if (cmd->state != CMD_PENDING) continue;
+		unsigned long expected = srtt[controlBucket(cmd->control)];
+		if (expected == 0) expected = 2 * COMMAND_FRAME_SIZE * byte_time;
+		unsigned long elapsed = now_us - cmd->sent;
+		if (elapsed < expected) t = now + (expected - elapsed + 999) / 1000;
+		else t = now + frameTime(COMMAND_FRAME_SIZE);				// late, the reply may be on the wire
+		if ((long)(t - until) < 0) until = t;
+		t = now + (elapsed < cmd->timeout ? (cmd->timeout - elapsed + 999) / 1000 : 0);	// resend
+		if ((long)(t - until) < 0) until = t;
+	}
+	unlockTable();
+	RadarCadence* cadences[] = {&heartbeats, &reports};
+	for (int i = 0; i < 2; i++) {
+		if (cadences[i]->period == 0) continue;
+		t = cadences[i]->last + cadences[i]->period + frameTime(FRAME_OVERHEAD + UNDERLYING_DATA_LENGTH);
+		if ((long)(t - now) > 0 && (long)(t - until) < 0) until = t;	// one that is late is left to the bound
+	}
+	if (publisher != NULL && publisher->pending()) {
+		t = publisher->nextDue();
+		if ((long)(t - now) <= 0) return now;
+		if ((long)(t - until) < 0) until = t;
+	}
+	if (link_timeout > 0) {
+		switch (recovery) {
+			case RECOVER_IDLE:
+				t = last_seen + (link == LINK_HEALTHY ? link_timeout : 2 * link_timeout) + 1;
+				break;
+			case RECOVER_RESET:
+				t = recovery_handle < 0 ? now : until;
+				break;
+			case RECOVER_RESTART:
+				t = recovery_started + 2 * link_timeout + 1;
+				break;
+			default:
+				t = until;
+				break;
+		}
+		if ((long)(t - now) <= 0) return now;
+		if ((long)(t - until) < 0) until = t;
 	}
+	return until;
 }
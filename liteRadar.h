@@ -81,72 +81,569 @@
 #define UNDERLYING					0x08		// control byte for underlying data
 #define SET_UNDERLYING				0x00		// command to set underlying data on/off
 #define GET_UNDERLYING				0x80		// command to get current undelying data byte
+#define UNDERLYING_DATA				0x01		// underlying data report, energies distances and speed
+#define UNDERLYING_DATA_LENGTH		5			// data bytes in an underlying data report
 
-#define TIME_TO_WAIT				5000		// time to wait on a return frame match
+// decoded sample types
+#define SAMPLE_UNDERLYING			1			// underlying data report
+#define SAMPLE_AMPLITUDE			2			// motion amplitude report
+#define SAMPLE_POSITION				3			// approaching / leaving report
+#define SPEED_STATIONARY			0x0A		// speed value for no radial movement
+
+// presence and motion event types
+#define EVENT_PRESENCE				1			// presence changed, values are 0 absent 1 present
+#define EVENT_MOTION				2			// motion changed, values are 0 none 1 stationary 2 active
+#define EVENT_ACTIVITY				3			// amplitude activity level changed, values are ACTIVITY_ levels
+#define EVENT_LINK					4			// link health changed, values are LINK_ states
+
+// link health, from the time since the last heartbeat or other frame
+#define LINK_HEALTHY				0			// heard from within the heartbeat timeout
+#define LINK_DEGRADED				1			// silent for longer than the timeout, stream resynced
+#define LINK_LOST					2			// silent for twice the timeout, recovery running
+
+// link recovery states
+#define RECOVER_IDLE				0			// not recovering
+#define RECOVER_RESET				1			// waiting on the reset command
+#define RECOVER_RESTART				2			// waiting for the module to talk after the reset
+#define RECOVER_CONFIG				3			// reapplying the recovery profile
+
+#ifndef SAMPLE_BUFFER_SIZE
+#define SAMPLE_BUFFER_SIZE			16			// decoded samples held for the application, power of two
+#endif
+
+#define TIME_TO_WAIT				5000		// longest wait on a return frame match
+
+// adaptive reply timeouts, from the round trips measured for each COUNT_ bucket
+#define RTO_INITIAL					500			// ms to wait on a reply before a round trip has been measured
+#define RTO_MIN						20			// ms floor of the reply timeout
+#define RTT_K						4			// deviations added to the smoothed round trip
+#ifndef COMMAND_RETRIES
+#define COMMAND_RETRIES				2			// times a command is sent again, each wait twice the last
+#endif
+
+// low power scheduling
+#define RADAR_BAUD					115200		// uart speed of the module
+#ifndef PRESENCE_LATENCY
+#define PRESENCE_LATENCY			100			// default ms a presence or motion report may wait to be seen
+#endif
+
+// asynchronous command engine
+#ifndef MAX_PENDING
+#define MAX_PENDING					4			// commands that may wait on a reply at the same time
+#endif
+#define CMD_FREE					0			// slot is not in use
+#define CMD_PENDING					1			// request sent, waiting on the reply
+#define CMD_DONE					2			// reply received and matched
+#define CMD_FAILED					3			// reply received but did not echo the data sent
+#define CMD_TIMEOUT					4			// no reply after every retry
+#define CMD_QUEUED					5			// submitted in background mode, the reader task sends it
+
+// submit errors, returned instead of a handle
+#define SUBMIT_BUSY					-1			// MAX_PENDING commands in flight, try again later
+#define SUBMIT_INVALID				-2			// not a command that can be sent, never try again
+
+// command results, why the last collected command failed
+#define RESULT_OK					0			// reply received and matched
+#define RESULT_NACK					1			// reply received but it did not echo the data sent
+#define RESULT_CHECKSUM				2			// no good reply, frames with bad checksums came in meanwhile
+#define RESULT_TIMEOUT				3			// no reply after every retry
+#define RESULT_BUSY					4			// not sent, MAX_PENDING commands were in flight
+#define RESULT_INVALID				5			// not sent, not a command that can be sent
+
+// configuration parameters, also bit positions in configuration masks
+#define PARAM_PRESENCE_THRESHOLD	0
+#define PARAM_PRESENCE_RANGE		1
+#define PARAM_MOTION_THRESHOLD		2
+#define PARAM_MOTION_RANGE			3
+#define PARAM_MOTION_VALID_TIME		4
+#define PARAM_STATIONARY_VALID_TIME	5
+#define PARAM_ABSENCE_VALID_TIME	6
+#define PARAM_SCENARIO				7
+#define PARAM_SENSITIVITY			8
+#define PARAM_TIME_OF_ABSENCE		9
+#define PARAM_UNDERLYING			10
+#define PARAM_COUNT					11
+#ifndef RADAR_NO_SCENARIOS
+#define PARAM_ALL_MASK				0x07FF		// every parameter
+#else
+#define PARAM_ALL_MASK				0x047F		// every parameter left after stripping scenarios
+#endif
+#define PARAM_CUSTOM_MASK			0x007F		// parameters that can only be set in custom mode
+
+#include "radarCommands.h"
+
+// receive parser states
+#define PARSE_HEAD1					0			// hunting for the first header byte
+#define PARSE_HEAD2					1			// expecting the second header byte
+#define PARSE_CONTROL				2			// expecting the control byte
+#define PARSE_COMMAND				3			// expecting the command byte
+#define PARSE_LENGTH_H				4			// expecting the high byte of the data length
+#define PARSE_LENGTH_L				5			// expecting the low byte of the data length
+#define PARSE_DATA					6			// reading the declared number of data bytes
+#define PARSE_CHECKSUM				7			// expecting the checksum byte
+#define PARSE_END1					8			// expecting the first end byte
+#define PARSE_END2					9			// expecting the second end byte
+
+// receive ring buffer, size must be a power of two and hold at least two RX_FRAME_SIZE frames
+#ifndef RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE				128			// bytes drained from the stream ahead of the parser
+#endif
+#define RX_BUFFER_MASK				(RX_BUFFER_SIZE - 1)
+
+// receive modes
+#define RECEIVE_POLL				0			// updateStatus() reads the stream
+#define RECEIVE_PUSH				1			// a receive callback calls receive(), updateStatus() only parses
+
+// orders the receive buffer writes of the producer against the reads of the parser. A single
+// core AVR only needs the compiler kept from reordering, avr-gcc has no __sync_synchronize
+#ifndef RADAR_MEMORY_BARRIER
+#if defined(__AVR__)
+#define RADAR_MEMORY_BARRIER()		__asm__ __volatile__("" ::: "memory")
+#elif defined(__ATOMIC_SEQ_CST)
+#define RADAR_MEMORY_BARRIER()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define RADAR_MEMORY_BARRIER()		__sync_synchronize()
+#endif
+#endif
+
+// frame capacities, a frame is 9 bytes of header, checksum and trailer plus its data
+#define FRAME_OVERHEAD				9			// bytes in a frame besides the data
+#define COMMAND_FRAME_SIZE			13			// largest request, 4 data bytes
+#ifndef RX_FRAME_SIZE
+#define RX_FRAME_SIZE				64			// largest frame accepted from the module
+#endif
 
 /*!
- * @struct		Frame
+ * @struct		FrameBuffer
+ * @brief		frame with room for N bytes, header to trailer
  * @param		msg		buffer to hold the frame
  * @param		l		length of the frame
  */
 
-struct Frame {
-	unsigned char msg[20];
+template <unsigned int N>
+struct FrameBuffer {
+	static_assert(N > FRAME_OVERHEAD, "a frame needs room for at least one data byte");
+	static const unsigned int capacity = N;
+	unsigned char msg[N];
+	unsigned int l;
+};
+
+typedef FrameBuffer<COMMAND_FRAME_SIZE> Frame;		// requests sent to the module
+typedef FrameBuffer<RX_FRAME_SIZE> RxFrame;			// frames received from the module
+static_assert(2 * RX_FRAME_SIZE <= RX_BUFFER_SIZE, "RX_BUFFER_SIZE must hold two RX_FRAME_SIZE frames");
+static_assert((RX_BUFFER_SIZE & (RX_BUFFER_SIZE - 1)) == 0, "RX_BUFFER_SIZE must be a power of two");
+static_assert((SAMPLE_BUFFER_SIZE & (SAMPLE_BUFFER_SIZE - 1)) == 0, "SAMPLE_BUFFER_SIZE must be a power of two");
+static_assert(REQUEST_FRAME_SIZE <= COMMAND_FRAME_SIZE, "request frames are copied into a Frame");
+
+/*!
+ * @struct		FrameView
+ * @brief		read only view of a received frame. msg points into the receive buffer
+ * 				and is only valid until the next call that reads from the module
+ * @param		msg		first byte of the frame
+ * @param		l		length of the frame
+ */
+
+struct FrameView {
+	const unsigned char* msg;
 	unsigned int l;
 };
 
+/*!
+ * @struct		RadarSample
+ * @brief		decoded report from the module. Only the fields for the sample type are set
+ * @param		t					millis() when the frame was decoded
+ * @param		type				one of the SAMPLE_ types
+ * @param		presence_energy		energy of the stationary target, 0-250
+ * @param		presence_gate		distance of the stationary target in 0.5m steps
+ * @param		motion_energy		energy of the moving target, 0-250
+ * @param		motion_gate			distance of the moving target in 0.5m steps
+ * @param		speed				speed of the moving target in 0.5m/s steps, SPEED_STATIONARY is 0
+ * @param		amplitude			motion amplitude, 0-100
+ * @param		position			0 for none, 1 for approaching, 2 for leaving
+ */
+
+struct RadarSample {
+	unsigned long t;
+	byte type;
+	byte presence_energy;
+	byte presence_gate;
+	byte motion_energy;
+	byte motion_gate;
+	byte speed;
+	byte amplitude;
+	byte position;
+};
+
+/*!
+ * @struct		RadarEvent
+ * @brief		presence or motion transition
+ * @param		t			millis() when the report was processed
+ * @param		type		EVENT_PRESENCE, EVENT_MOTION, EVENT_ACTIVITY or EVENT_LINK
+ * @param		previous	state before the report
+ * @param		current		state reported
+ */
+
+struct RadarEvent {
+	unsigned long t;
+	byte type;
+	byte previous;
+	byte current;
+};
+
+class RadarHistory;
+class RadarProfile;
+class RadarAmplitude;
+class RadarCaptureSink;
+class RadarDumpSink;
+class RadarPublisher;
+class RadarZones;
+template <typename T> class RadarQueue;
+
+/*!
+ * @class RadarLock
+ * @brief lock around the command table in background mode, implemented with whatever the
+ * 		platform has, a FreeRTOS mutex on the ESP32 or std::mutex on a Linux host
+ */
+
+class RadarLock {
+	public:
+		virtual ~RadarLock() {}
+		virtual void lock() = 0;
+		virtual void unlock() = 0;
+};
+
+/*!
+ * @typedef		RadarEventCallback
+ * @brief		function called on every presence or motion transition. It runs inside
+ * 				updateStatus(), and inside blocking set / get calls, so it must not call
+ * 				the blocking api itself
+ */
+
+typedef void (*RadarEventCallback)(const RadarEvent* event, void* context);
+
+/*!
+ * @typedef		RadarSleepCallback
+ * @brief		function that puts the processor to sleep for up to ms, waking early on an
+ * 				interrupt is fine. The uart must keep receiving while it sleeps, idle sleep on
+ * 				AVR or light sleep with uart wakeup on the ESP32
+ */
+
+typedef void (*RadarSleepCallback)(unsigned long ms, void* context);
+
+/*!
+ * @struct		RadarCadence
+ * @brief		learned period of a kind of frame the module sends on its own
+ * @param		last		millis() when one was last received
+ * @param		period		average time between them in ms, 0 until two have been seen
+ * @param		seen		true once one has been received
+ */
+
+struct RadarCadence {
+	unsigned long last;
+	unsigned long period;
+	bool seen;
+};
+
+/*!
+ * @struct		PendingCommand
+ * @brief		entry in the table of commands waiting on a reply from the module
+ * @param		control		control byte of the request, replies are matched on it
+ * @param		command		command byte of the request, replies are matched on it
+ * @param		state		one of the CMD_ values
+ * @param		check_data	true if the reply must echo data, as set commands do
+ * @param		data		data sent, replaced by the returned data on a get
+ * @param		sent		micros() when the request was last sent
+ * @param		attempts	number of times the request has been sent
+ * @param		corrupt		true if a frame with a bad checksum came in while it was waiting
+ * @param		timeout		us to wait on the reply to the last send
+ * @param		checksums	bad checksum count when the request was last sent
+ */
+
+struct PendingCommand {
+	byte control;
+	byte command;
+	byte state;
+	bool check_data;
+	unsigned char data[4];
+	unsigned long sent;
+	byte attempts;
+	bool corrupt;
+	unsigned long timeout;
+	unsigned long checksums;
+};
+
+// frame counter buckets, by control byte
+#define COUNT_SYSTEM				0			// heartbeats and reset replies
+#define COUNT_WORKING_STATUS		1			// WORKING_STATUS
+#define COUNT_RANGE					2			// WORKING_STATUS_RANGE
+#define COUNT_CUSTOM				3			// CUSTOM and UNDERLYING, they share a control byte
+#define COUNT_HUMAN_STATUS			4			// HUMAN_STATUS
+#define COUNT_OTHER					5			// any other control byte
+#define COUNT_CONTROLS				6
+
+/*!
+ * @struct		RadarCounters
+ * @brief		link counters kept by the radar on every byte, frame and command
+ * @param		frames		valid frames received, by COUNT_ bucket
+ * @param		ignored		valid frames that were not a reply, a report or a heartbeat
+ * @param		bad_checksums	frames dropped for a checksum mismatch
+ * @param		bad_frames	frames dropped for a bad length or trailer
+ * @param		resync_bytes	bytes skipped while hunting for HEAD1
+ * @param		overruns	samples dropped because the sample buffer was not drained
+ * @param		commands	commands sent
+ * @param		busy		commands refused because MAX_PENDING were already in flight
+ * @param		replies		commands answered with a good reply
+ * @param		failures	commands answered with a reply that did not match
+ * @param		retries		requests sent again after a reply timeout
+ * @param		timeouts	commands that got no reply after every retry
+ * @param		rtt_min		shortest round trip of a replied command in us
+ * @param		rtt_avg		average round trip in us
+ * @param		rtt_max		longest round trip in us
+ */
+
+struct RadarCounters {
+	unsigned long frames[COUNT_CONTROLS];
+	unsigned long ignored;
+	unsigned long bad_checksums;
+	unsigned long bad_frames;
+	unsigned long resync_bytes;
+	unsigned long overruns;
+	unsigned long commands;
+	unsigned long busy;
+	unsigned long replies;
+	unsigned long failures;
+	unsigned long retries;
+	unsigned long timeouts;
+	unsigned long rtt_min;
+	unsigned long rtt_avg;
+	unsigned long rtt_max;
+};
+
+/*!
+ * @struct		RadarParamInfo
+ * @brief		how a configuration parameter is read and written
+ * @param		control		control byte for the parameter
+ * @param		set			command byte to set it
+ * @param		get			command byte to get it
+ * @param		width		number of data bytes, 1 or 4
+ * @param		request		precomputed get request frame in flash
+ */
+
+struct RadarParamInfo {
+	byte control;
+	byte set;
+	byte get;
+	byte width;
+	const unsigned char* request;
+};
+
+extern const RadarParamInfo radar_params[PARAM_COUNT];
+
+/*!
+ * @struct		RadarConfig
+ * @brief		snapshot of the module settings. mode is the custom mode used when a snapshot
+ * 				with custom mode parameters is applied, the module cannot report it
+ */
+
+struct RadarConfig {
+	byte mode;
+	byte presence_threshold;
+	byte presence_range;
+	byte motion_threshold;
+	byte motion_range;
+	unsigned long motion_valid_time;
+	unsigned long stationary_valid_time;
+	unsigned long absence_valid_time;
+	byte scenario;
+	byte sensitivity;
+	byte time_of_absence;
+	byte underlying;
+};
+
+unsigned long configValue(const RadarConfig* config, byte param);
+void setConfigValue(RadarConfig* config, byte param, unsigned long value);
+byte frameChecksum(const unsigned char* msg, unsigned int length);
+
 /*!
  * @class class structure for the radar device
  *
  */
 
 class Radar {
+	friend class RadarProfile;
+	friend class RadarCalibration;
 	private:
 		Stream *stream;
 		bool presence;
 		byte motion;
+		unsigned char rx_buf[RX_BUFFER_SIZE];
+		volatile unsigned int rx_head;				// only moved by the producer
+		volatile unsigned int rx_start;				// only moved by the parser
+		volatile unsigned int rx_tail;				// bytes before it are free, only moved by the parser
+		unsigned int rx_pos;
+		byte receive_mode;
+		RxFrame rx;
+		byte rx_state;
+		byte rx_checksum;
+		unsigned int rx_length;
+		unsigned int rx_count;
+		unsigned int fillBuffer();
+		bool parseByte(byte c);
 		void putFrame(Frame* frame);
-		bool getFrame(Frame* frame);
-		void printFrame(Frame* frame);
+		bool getFrame(FrameView* frame);
+		void printFrame(const FrameView* frame);
 		unsigned int char_to_int(unsigned char* data);
 		void int_to_char(unsigned char* data, unsigned int i);
 		bool buildFrame(Frame* frame, byte control, byte command, unsigned int data_length, unsigned char* data);
-		bool validateFrame(Frame* frame, byte control, byte command, unsigned char* data, bool check_data);
-		bool setParam(byte control, byte command, unsigned char* data);
-		bool getParam(byte control, byte command, unsigned char* data);
+		bool validateFrame(const FrameView* frame, byte control, byte command, unsigned char* data, bool check_data);
+		PendingCommand pending[MAX_PENDING];
+		bool status_changed;
+		RadarConfig config;
+		unsigned int config_valid;
+		void cacheParam(const PendingCommand* cmd);
+		unsigned long readParam(byte param, byte* result);
+		int trackCommand(byte control, byte command, unsigned char* data, bool check_data);
+		bool tableRoom();
+		int submitCommand(byte control, byte command, unsigned char* data, bool check_data);
+		int submitRequest(const unsigned char* request, bool check_data);
+		bool matchCommand(const FrameView* frame);
+		void expireCommands();
+		void armCommand(PendingCommand* cmd);
+		bool sendCommand(PendingCommand* cmd);
+		unsigned long srtt[COUNT_CONTROLS];
+		unsigned long rttvar[COUNT_CONTROLS];
+		void trackRtt(byte control, unsigned long rtt);
+		byte last_result;
+		bool waitCommand(int handle, unsigned char* data, byte* result);
+		RadarSample samples[SAMPLE_BUFFER_SIZE];
+		unsigned int sample_head;
+		unsigned int sample_tail;
+		RadarEventCallback event_callback;
+		void* event_context;
+		RadarHistory* history;
+		RadarAmplitude* amplitude_stats;
+		RadarPublisher* publisher;
+		RadarZones* zones;
+		void emitEvent(byte type, byte previous, byte current);
+		RadarSample* nextSample(byte type);
+		bool decodeFrame(const FrameView* frame);
+		void dispatchFrame(const FrameView* frame);
+		void pump();
+		unsigned long link_timeout;
+		unsigned long last_seen;
+		unsigned long recovery_started;
+		byte link;
+		byte recovery;
+		int recovery_handle;
+		RadarProfile* recovery_profile;
+		void resync();
+		void setLink(byte state);
+		void watchLink();
+		RadarCounters counters;
+		unsigned long rtt_total;
+		RadarCounters shared_counters;
+		void countFrame(byte control);
+		byte controlBucket(byte control);
+		RadarCaptureSink* capture_sink;
+		RadarDumpSink* dump_sink;
+		RadarLock* table_lock;
+		RadarQueue<RadarEvent>* event_queue;
+		RadarQueue<RadarSample>* sample_queue;
+		RadarSample decoded;
+		void lockTable();
+		void unlockTable();
+		void sendQueued();
+		void idle();
+		unsigned long byte_time;
+		unsigned long latency_bound;
+		RadarCadence heartbeats;
+		RadarCadence reports;
+		RadarSleepCallback sleep_callback;
+		void* sleep_context;
+		void trackCadence(RadarCadence* cadence, unsigned long now);
+		unsigned long frameTime(unsigned int bytes);
+		bool setParam(byte control, byte command, unsigned char* data, byte* result);
+		bool getParam(byte control, byte command, unsigned char* data, byte* result);
 		unsigned int getDataLength(byte control, byte command);
 	public:
 		Radar(Stream *s);
 		void streamFrames(unsigned long t);
-		bool resetRadar();
-
-		bool setScenario(byte scenario);
-		byte getScenario();
-		bool setSensitivity(byte sensitivity);
-		byte getSensitivity();
-		bool setTimeOfAbsence(byte threshold);
-		byte getTimeOfAbsence();
-
-		bool openCustomMode(byte mode);
-		bool exitCustomMode();
-		bool setPresenceThreshold(byte threshold);
-		byte getPresenceThreshold();
-		bool setPresenceRange(byte range);
-		byte getPresenceRange();
-		bool setStationaryValidTime(unsigned int t);
-		unsigned int getStationaryValidTime();
-		bool setMotionThreshold(byte threshold);
-		byte getMotionThreshold();
-		bool setMotionRange(byte range);
-		byte getMotionRange();
-		bool setMotionValidTime(unsigned int t);
-		unsigned int getMotionValidTime();
-		bool setAbsenceValidTime(unsigned int t);
-		unsigned int getAbsenceValidTime();
+		bool setCapture(RadarCaptureSink* sink);
+		void setDump(RadarDumpSink* sink);
+		bool setReceiveMode(byte mode);
+		unsigned int receive();
+		void setBackground(RadarLock* lock);
+		void setEventQueue(RadarQueue<RadarEvent>* q);
+		void setSampleQueue(RadarQueue<RadarSample>* q);
+		bool resetRadar(byte* result = NULL);
+
+#ifndef RADAR_NO_SCENARIOS
+		bool setScenario(byte scenario, byte* result = NULL);
+		byte getScenario(byte* result = NULL);
+		bool setSensitivity(byte sensitivity, byte* result = NULL);
+		byte getSensitivity(byte* result = NULL);
+		bool setTimeOfAbsence(byte threshold, byte* result = NULL);
+		byte getTimeOfAbsence(byte* result = NULL);
+#endif
+
+		bool openCustomMode(byte mode, byte* result = NULL);
+		bool exitCustomMode(byte* result = NULL);
+		bool setPresenceThreshold(byte threshold, byte* result = NULL);
+		byte getPresenceThreshold(byte* result = NULL);
+		bool setPresenceRange(byte range, byte* result = NULL);
+		byte getPresenceRange(byte* result = NULL);
+		bool setStationaryValidTime(unsigned int t, byte* result = NULL);
+		unsigned int getStationaryValidTime(byte* result = NULL);
+		bool setMotionThreshold(byte threshold, byte* result = NULL);
+		byte getMotionThreshold(byte* result = NULL);
+		bool setMotionRange(byte range, byte* result = NULL);
+		byte getMotionRange(byte* result = NULL);
+		bool setMotionValidTime(unsigned int t, byte* result = NULL);
+		unsigned int getMotionValidTime(byte* result = NULL);
+		bool setAbsenceValidTime(unsigned int t, byte* result = NULL);
+		unsigned int getAbsenceValidTime(byte* result = NULL);
 	
-		bool setUnderlying(byte onoff);
-		byte getUnderlying();
+		bool setUnderlying(byte onoff, byte* result = NULL);
+		byte getUnderlying(byte* result = NULL);
+
+		bool readConfig();
+		bool getConfig(RadarConfig* c);
+		bool applyConfig(const RadarConfig* desired);
+		void invalidateConfig();
 		
+		int submitSet(byte control, byte command, unsigned char* data);
+		int submitGet(byte control, byte command);
+		byte commandState(int handle);
+		bool commandResult(int handle, unsigned char* data, byte* result = NULL);
+		void cancelCommand(int handle);
+		byte lastResult();
+		unsigned long commandTimeout(byte control);
+
+		unsigned int samplesAvailable();
+		unsigned int readSamples(RadarSample* out, unsigned int max);
+
+		void onEvent(RadarEventCallback callback, void* context = NULL);
+		void setHistory(RadarHistory* h);
+		void setAmplitudeStats(RadarAmplitude* a);
+		void setPublisher(RadarPublisher* p);
+		void setZones(RadarZones* z);
+
+		void setHeartbeatTimeout(unsigned long t);
+		void setRecoveryProfile(RadarProfile* p);
+		byte linkState();
+		byte recoveryState();
+		unsigned long lastSeen();
+
+		void getCounters(RadarCounters* c);
+		void resetCounters();
+
+		void setBaudRate(unsigned long baud);
+		void setLatencyBound(unsigned long ms);
+		void onSleep(RadarSleepCallback sleep, void* context = NULL);
+		unsigned long heartbeatPeriod();
+		unsigned long reportPeriod();
+		unsigned long sleepUntil();
+
 		bool updateStatus();
 		bool isPresent();
 		bool isMoving();
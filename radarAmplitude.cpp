@@ -0,0 +1,185 @@
+/*
+ * RadarAmplitude keeps the last n motion amplitude reports in a ring along with their sum and
+ * sum of squares, so adding a report and reading the mean or variance never walks the window.
+ * The minimum and maximum come from two monotonic deques of window positions. A new report
+ * drops the entries behind it that it beats, since they leave the window first and can never
+ * be the extreme again, so each report is pushed and popped at most once whatever the window
+ * holds. The moving average is kept scaled by AMPLITUDE_ONE.
+ *
+ */
+
+
+#include "radarAmplitude.h"
+
+RadarAmplitude::RadarAmplitude(byte* storage, byte* extremes, unsigned int n, byte shift)
+	: window(storage), size(n > AMPLITUDE_MAX_WINDOW ? AMPLITUDE_MAX_WINDOW : n), ema_shift(shift),
+	  low_level(10), high_level(50) {
+	lowest.index = extremes;
+	highest.index = extremes + size;
+	clear();
+}
+
+/*!
+ * @fn clear
+ * @brief empties the window and resets the moving average
+ */
+void RadarAmplitude::clear() {
+	head = 0;
+	count = 0;
+	sum = 0;
+	sum_squares = 0;
+	lowest.front = 0;
+	lowest.count = 0;
+	highest.front = 0;
+	highest.count = 0;
+	ema_value = 0;
+	activity = ACTIVITY_IDLE;
+}
+
+/*!
+ * @fn expire
+ * @brief drops the oldest entry of a deque if it is the report leaving the window
+ * @param q deque to trim
+ * @param position window position of the report leaving
+ */
+void RadarAmplitude::expire(AmplitudeDeque* q, unsigned int position) {
+	if (q->count > 0 && q->index[q->front] == position) {
+		q->front = (q->front + 1) % size;
+		q->count--;
+	}
+}
+
+/*!
+ * @fn push
+ * @brief adds the newest report to a deque, dropping the entries it beats from the back
+ * @param q deque to add to
+ * @param position window position of the newest report
+ * @param rising true for the minimum, whose deque rises from front to back, false for the maximum
+ */
+void RadarAmplitude::push(AmplitudeDeque* q, unsigned int position, bool rising) {
+	byte value = window[position];
+	while (q->count > 0) {
+		byte back = window[q->index[(q->front + q->count - 1) % size]];
+		if (rising ? back < value : back > value) break;
+		q->count--;
+	}
+	q->index[(q->front + q->count) % size] = position;
+	q->count++;
+}
+
+/*!
+ * @fn add
+ * @brief adds a report to the window, dropping the oldest one when the window is full
+ * @param amplitude motion amplitude, 0-100
+ * @returns true if the activity level changed
+ */
+bool RadarAmplitude::add(byte amplitude) {
+	if (size == 0) return false;
+	if (count == size) {
+		byte oldest = window[head];
+		sum -= oldest;
+		sum_squares -= (unsigned long)oldest * oldest;
+		expire(&lowest, head);
+		expire(&highest, head);
+		count--;
+	}
+	window[head] = amplitude;
+	push(&lowest, head, true);
+	push(&highest, head, false);
+	head = (head + 1) % size;
+	sum += amplitude;
+	sum_squares += (unsigned long)amplitude * amplitude;
+	if (count == 0) {
+		ema_value = (long)amplitude << AMPLITUDE_FRACTION;
+	} else {
+		ema_value += (((long)amplitude << AMPLITUDE_FRACTION) - ema_value) >> ema_shift;
+	}
+	count++;
+	byte previous = activity;
+	unsigned int average = ema() >> AMPLITUDE_FRACTION;
+	if (average >= high_level) activity = ACTIVITY_HIGH;
+	else if (average >= low_level) activity = ACTIVITY_LOW;
+	else activity = ACTIVITY_IDLE;
+	return activity != previous;
+}
+
+/*!
+ * @fn setLevels
+ * @brief sets the moving average levels the activity level is judged against
+ * @param low average at or above which activity is ACTIVITY_LOW
+ * @param high average at or above which activity is ACTIVITY_HIGH
+ */
+void RadarAmplitude::setLevels(byte low, byte high) {
+	low_level = low;
+	high_level = high;
+}
+
+/*!
+ * @fn samples
+ * @brief returns the number of reports in the window
+ */
+unsigned int RadarAmplitude::samples() {
+	return count;
+}
+
+/*!
+ * @fn mean
+ * @brief returns the mean of the window, scaled by AMPLITUDE_ONE
+ */
+unsigned int RadarAmplitude::mean() {
+	if (count == 0) return 0;
+	return (sum << AMPLITUDE_FRACTION) / count;
+}
+
+/*!
+ * @fn variance
+ * @brief returns the population variance of the window, scaled by AMPLITUDE_ONE
+ */
+unsigned long RadarAmplitude::variance() {
+	if (count == 0) return 0;
+	unsigned long m = mean();
+	unsigned long squares = (sum_squares << AMPLITUDE_FRACTION) / count;
+	unsigned long m2 = (m * m) >> AMPLITUDE_FRACTION;
+	return squares > m2 ? squares - m2 : 0;
+}
+
+/*!
+ * @fn minimum
+ * @brief returns the lowest report in the window
+ */
+byte RadarAmplitude::minimum() {
+	return lowest.count > 0 ? window[lowest.index[lowest.front]] : 0;
+}
+
+/*!
+ * @fn maximum
+ * @brief returns the highest report in the window
+ */
+byte RadarAmplitude::maximum() {
+	return highest.count > 0 ? window[highest.index[highest.front]] : 0;
+}
+
+/*!
+ * @fn ema
+ * @brief returns the exponential moving average, scaled by AMPLITUDE_ONE
+ */
+unsigned int RadarAmplitude::ema() {
+	return (unsigned int)ema_value;
+}
+
+/*!
+ * @fn trend
+ * @brief returns the moving average minus the window mean, scaled by AMPLITUDE_ONE. Positive
+ * 		when the amplitude is rising faster than the window follows
+ */
+long RadarAmplitude::trend() {
+	return ema_value - (long)mean();
+}
+
+/*!
+ * @fn level
+ * @brief returns the activity level, ACTIVITY_IDLE, ACTIVITY_LOW or ACTIVITY_HIGH
+ */
+byte RadarAmplitude::level() {
+	return activity;
+}
@@ -0,0 +1,80 @@
+/*!
+ * @headerfile radarAmplitude.h
+ * @details	sliding window statistics over the motion amplitude reports. The window lives in
+ * 			storage the application provides, n bytes for the reports and 2 * n for the min / max
+ * 			bookkeeping, and every report updates the statistics in constant time, amortized for
+ * 			the min / max, so the raw amplitude stream never has to leave the MCU.
+ * 			Mean, variance and the moving average are fixed point with AMPLITUDE_FRACTION
+ * 			fractional bits
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarAmplitude_h
+#define radarAmplitude_h
+
+#define AMPLITUDE_FRACTION			8			// fractional bits of the fixed point results
+#define AMPLITUDE_ONE				(1UL << AMPLITUDE_FRACTION)
+#define AMPLITUDE_MAX_WINDOW		256			// keeps the sum of squares inside 32 bits
+#define AMPLITUDE_EMA_SHIFT			3			// default moving average weight, 1/8
+
+// activity levels, from the moving average
+#define ACTIVITY_IDLE				0			// below the low level
+#define ACTIVITY_LOW				1			// between the levels
+#define ACTIVITY_HIGH				2			// above the high level
+
+/*!
+ * @struct		AmplitudeDeque
+ * @brief		window positions of the reports that can still become the minimum or maximum,
+ * 				oldest first, in a ring of window size
+ * @param		index		ring of window positions
+ * @param		front		ring position of the oldest entry
+ * @param		count		number of entries
+ */
+
+struct AmplitudeDeque {
+	byte* index;
+	unsigned int front;
+	unsigned int count;
+};
+
+/*!
+ * @class RadarAmplitude
+ * @brief running mean, variance, min / max and moving average of the last window reports
+ *
+ */
+
+class RadarAmplitude {
+	private:
+		byte* window;
+		unsigned int size;
+		unsigned int head;
+		unsigned int count;
+		unsigned long sum;
+		unsigned long sum_squares;
+		AmplitudeDeque lowest;
+		AmplitudeDeque highest;
+		byte ema_shift;
+		long ema_value;
+		byte low_level;
+		byte high_level;
+		byte activity;
+		void expire(AmplitudeDeque* q, unsigned int position);
+		void push(AmplitudeDeque* q, unsigned int position, bool rising);
+	public:
+		RadarAmplitude(byte* storage, byte* extremes, unsigned int n, byte shift = AMPLITUDE_EMA_SHIFT);
+		void clear();
+		bool add(byte amplitude);
+		void setLevels(byte low, byte high);
+
+		unsigned int samples();
+		unsigned int mean();
+		unsigned long variance();
+		byte minimum();
+		byte maximum();
+		unsigned int ema();
+		long trend();
+		byte level();
+};
+
+#endif
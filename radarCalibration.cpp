@@ -0,0 +1,396 @@
+/*
+ * RadarCalibration keeps a count, a sum, a sum of squares and a peak per gate for each of the
+ * two targets, which is enough for the mean and standard deviation of the background energy
+ * without holding the reports. A gate threshold is the larger of the mean plus
+ * CALIBRATION_SIGMAS deviations and the peak, plus CALIBRATION_MARGIN. The module takes one
+ * threshold for all gates, so the suggestion is the highest gate threshold within range.
+ *
+ */
+
+
+#include "radarCalibration.h"
+#include "radarProfile.h"
+
+RadarCalibration::RadarCalibration()
+	: radar(NULL), state(CALIBRATION_IDLE), handle(-1), underlying(0), started(0), window(CALIBRATION_WINDOW),
+	  progress(0), failed(false) {
+	max_range[0] = CALIBRATION_GATES - 1;
+	max_range[1] = CALIBRATION_GATES - 1;
+	clear();
+}
+
+/*!
+ * @fn clear
+ * @brief forgets the energy collected so far. The ranges are kept
+ */
+void RadarCalibration::clear() {
+	memset(noise, 0, sizeof(noise));
+}
+
+/*!
+ * @fn setRange
+ * @brief sets the ranges the room needs covered. The suggested ranges are only shorter when the
+ * 		far gates are too noisy
+ * @param presence_range values from 0 (0m) to 0A (5m), 0A by default
+ * @param motion_range values from 0 (0m) to 0A (5m), 0A by default
+ */
+void RadarCalibration::setRange(byte presence_range, byte motion_range) {
+	max_range[0] = presence_range < CALIBRATION_GATES ? presence_range : CALIBRATION_GATES - 1;
+	max_range[1] = motion_range < CALIBRATION_GATES ? motion_range : CALIBRATION_GATES - 1;
+}
+
+/*!
+ * @fn addEnergy
+ * @brief adds the energy of one target at its gate. A gate stops counting once its count
+ * 		is full, which keeps the sum of squares from overflowing
+ */
+static void addEnergy(GateNoise* n, byte gate, byte energy) {
+	if (gate >= CALIBRATION_GATES || n->count[gate] == 0xFFFF) return;
+	n->count[gate]++;
+	n->sum[gate] += energy;
+	n->squares[gate] += (unsigned long)energy * energy;
+	if (energy > n->peak[gate]) n->peak[gate] = energy;
+}
+
+/*!
+ * @fn add
+ * @brief adds an underlying data report to the background energy, other reports are ignored
+ * @param sample report decoded by the radar
+ */
+void RadarCalibration::add(const RadarSample* sample) {
+	if (sample->type != SAMPLE_UNDERLYING) return;
+	addEnergy(&noise[0], sample->presence_gate, sample->presence_energy);
+	addEnergy(&noise[1], sample->motion_gate, sample->motion_energy);
+}
+
+/*!
+ * @fn begin
+ * @brief starts a calibration, the room should be empty until it finishes. The underlying data
+ * 		switch is read from the module, then underlying data is turned on, and back off
+ * 		afterwards if it was off. The rest is driven by poll()
+ * @param r radar to calibrate
+ * @param ms how long to collect the background energy for
+ * @returns true if the calibration was started
+ */
+bool RadarCalibration::begin(Radar *r, unsigned long ms) {
+	if (state != CALIBRATION_IDLE && state != CALIBRATION_FINISHED && state != CALIBRATION_FAILED) return false;
+	radar = r;
+	window = ms;
+	handle = -1;
+	failed = false;
+	clear();
+	progress = millis();
+	state = CALIBRATION_READING;
+	submitRead();
+	return true;
+}
+
+/*!
+ * @fn submitRead
+ * @brief asks the module for the underlying data switch unless a command is already in flight
+ * @returns true once the command is in flight
+ */
+bool RadarCalibration::submitRead() {
+	if (handle >= 0) return true;
+	handle = radar->submitGet(UNDERLYING, GET_UNDERLYING);
+	if (handle < 0) return false;
+	progress = millis();
+	return true;
+}
+
+/*!
+ * @fn submitUnderlying
+ * @brief sends the underlying data switch unless a command is already in flight
+ * @param onoff 0 or 1
+ * @returns true once the command is in flight
+ */
+bool RadarCalibration::submitUnderlying(byte onoff) {
+	if (handle >= 0) return true;
+	unsigned char data[] = {0x00, 0x00, 0x00, onoff};
+	handle = radar->submitSet(UNDERLYING, SET_UNDERLYING, data);
+	if (handle < 0) return false;
+	progress = millis();
+	return true;
+}
+
+/*!
+ * @fn stalled
+ * @brief the calibration is stalled when it has no command in flight and could not send one
+ * 		for TIME_TO_WAIT ms, such as when other callers hold every slot in the pending table
+ * @returns true if the calibration should give up
+ */
+bool RadarCalibration::stalled() {
+	return handle < 0 && millis() - progress > TIME_TO_WAIT;
+}
+
+/*!
+ * @fn fail
+ * @brief ends the calibration as failed. If it was turning underlying data on, the switch is
+ * 		sent back off first when it was off before
+ * @returns true once the calibration has finished
+ */
+bool RadarCalibration::fail() {
+	handle = -1;
+	if (state == CALIBRATION_STARTING && !underlying) {
+		failed = true;
+		progress = millis();
+		state = CALIBRATION_STOPPING;
+		submitUnderlying(0x00);
+		return false;
+	}
+	state = CALIBRATION_FAILED;
+	return true;
+}
+
+/*!
+ * @fn collect
+ * @brief adds every sample waiting in the radar
+ */
+void RadarCalibration::collect() {
+	RadarSample buffered[4];
+	unsigned int n;
+	while ((n = radar->readSamples(buffered, 4)) > 0) {
+		for (unsigned int i = 0; i < n; i++) add(&buffered[i]);
+	}
+}
+
+/*!
+ * @fn finish
+ * @brief ends the calibration
+ * @returns CALIBRATION_FINISHED, or CALIBRATION_FAILED unless reports placed both the
+ * 		stationary and the moving target in the window
+ */
+byte RadarCalibration::finish() {
+	bool stationary = false;
+	bool moving = false;
+	for (byte i = 0; i < CALIBRATION_GATES; i++) {
+		if (noise[0].count[i] > 0) stationary = true;
+		if (noise[1].count[i] > 0) moving = true;
+	}
+	return (stationary && moving) ? CALIBRATION_FINISHED : CALIBRATION_FAILED;
+}
+
+/*!
+ * @fn poll
+ * @brief advances the calibration. Call it after each updateStatus() until it returns true.
+ * 		The calibration fails once a command could not be sent for TIME_TO_WAIT ms
+ * @returns true once the calibration has finished
+ */
+bool RadarCalibration::poll() {
+	unsigned char data[4];
+	if (state == CALIBRATION_STOPPING && stalled()) {
+		state = CALIBRATION_FAILED;						// underlying data may be left on
+		return true;
+	}
+	if ((state == CALIBRATION_READING || state == CALIBRATION_STARTING) && stalled()) return fail();
+	switch (state) {
+		case CALIBRATION_READING:
+			if (!submitRead()) return false;
+			if (radar->commandState(handle) == CMD_PENDING) return false;
+			if (!radar->commandResult(handle, data)) return fail();
+			handle = -1;
+			progress = millis();
+			underlying = data[3];
+			state = CALIBRATION_STARTING;
+			submitUnderlying(0x01);
+			return false;
+		case CALIBRATION_STARTING:
+			if (!submitUnderlying(0x01)) return false;
+			if (radar->commandState(handle) == CMD_PENDING) return false;
+			if (!radar->commandResult(handle, NULL)) return fail();
+			handle = -1;
+			collect();										// reports from before the window
+			clear();
+			started = millis();
+			state = CALIBRATION_COLLECTING;
+			return false;
+		case CALIBRATION_COLLECTING:
+			collect();
+			if (millis() - started < window) return false;
+			if (underlying) {
+				state = finish();
+				return true;
+			}
+			progress = millis();
+			state = CALIBRATION_STOPPING;
+			submitUnderlying(0x00);
+			return false;
+		case CALIBRATION_STOPPING:
+			if (!submitUnderlying(0x00)) return false;
+			if (radar->commandState(handle) == CMD_PENDING) return false;
+			radar->commandResult(handle, NULL);
+			handle = -1;
+			state = failed ? CALIBRATION_FAILED : finish();
+			return true;
+		case CALIBRATION_FINISHED:
+		case CALIBRATION_FAILED:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*!
+ * @fn calibrate
+ * @brief runs the whole calibration and waits for it to finish
+ * @param r radar to calibrate
+ * @param ms how long to collect the background energy for
+ * @returns true if the calibration finished with suggestions
+ */
+bool RadarCalibration::calibrate(Radar *r, unsigned long ms) {
+	if (!begin(r, ms)) return false;
+	while (!poll()) {
+		radar->idle();
+	}
+	return ok();
+}
+
+/*!
+ * @fn getState
+ * @brief returns the state of the calibration
+ * @returns one of the CALIBRATION_ states
+ */
+byte RadarCalibration::getState() {
+	return state;
+}
+
+/*!
+ * @fn ok
+ * @brief returns true if the last calibration finished with suggestions
+ */
+bool RadarCalibration::ok() {
+	return state == CALIBRATION_FINISHED;
+}
+
+/*!
+ * @fn samples
+ * @brief returns the number of reports with the target at a gate
+ * @param moving true for the moving target, false for the stationary one
+ * @param gate gate from 0 to 10
+ */
+unsigned int RadarCalibration::samples(bool moving, byte gate) {
+	return gate < CALIBRATION_GATES ? noise[moving].count[gate] : 0;
+}
+
+/*!
+ * @fn mean
+ * @brief returns the mean background energy at a gate
+ * @param moving true for the moving target, false for the stationary one
+ * @param gate gate from 0 to 10
+ */
+byte RadarCalibration::mean(bool moving, byte gate) {
+	if (samples(moving, gate) == 0) return 0;
+	return noise[moving].sum[gate] / noise[moving].count[gate];
+}
+
+/*!
+ * @fn deviation
+ * @brief returns the standard deviation of the background energy at a gate
+ * @param moving true for the moving target, false for the stationary one
+ * @param gate gate from 0 to 10
+ */
+byte RadarCalibration::deviation(bool moving, byte gate) {
+	if (samples(moving, gate) == 0) return 0;
+	unsigned long m = mean(moving, gate);
+	unsigned long squares = noise[moving].squares[gate] / noise[moving].count[gate];
+	unsigned long variance = squares > m * m ? squares - m * m : 0;
+	unsigned long root = 0;
+	while ((root + 1) * (root + 1) <= variance) root++;		// at most 255 steps
+	return root;
+}
+
+/*!
+ * @fn peak
+ * @brief returns the highest background energy at a gate
+ * @param moving true for the moving target, false for the stationary one
+ * @param gate gate from 0 to 10
+ */
+byte RadarCalibration::peak(bool moving, byte gate) {
+	return gate < CALIBRATION_GATES ? noise[moving].peak[gate] : 0;
+}
+
+/*!
+ * @fn gateThreshold
+ * @brief returns the lowest threshold that stays clear of the background energy at a gate
+ * @param moving true for the moving target, false for the stationary one
+ * @param gate gate from 0 to 10
+ * @returns threshold up to 250, 0 for a gate with no reports
+ */
+byte RadarCalibration::gateThreshold(bool moving, byte gate) {
+	if (samples(moving, gate) == 0) return 0;
+	unsigned int t = mean(moving, gate) + CALIBRATION_SIGMAS * deviation(moving, gate);
+	if (peak(moving, gate) > t) t = peak(moving, gate);
+	t += CALIBRATION_MARGIN;
+	return t < 250 ? t : 250;
+}
+
+/*!
+ * @fn suggestRange
+ * @brief cuts the gates off the far end of the range whose thresholds would be over
+ * 		CALIBRATION_CEILING
+ * @param moving true for the moving target, false for the stationary one
+ */
+byte RadarCalibration::suggestRange(bool moving) {
+	byte range = max_range[moving];
+	while (range > 0 && gateThreshold(moving, range) > CALIBRATION_CEILING) range--;
+	return range;
+}
+
+/*!
+ * @fn suggestThreshold
+ * @brief returns the highest gate threshold within the suggested range
+ * @param moving true for the moving target, false for the stationary one
+ */
+byte RadarCalibration::suggestThreshold(bool moving) {
+	byte range = suggestRange(moving);
+	byte threshold = CALIBRATION_MARGIN;
+	for (byte gate = 0; gate <= range; gate++) {
+		if (gateThreshold(moving, gate) > threshold) threshold = gateThreshold(moving, gate);
+	}
+	return threshold;
+}
+
+/*!
+ * @fn presenceThreshold
+ * @brief returns the suggested presence threshold
+ */
+byte RadarCalibration::presenceThreshold() {
+	return suggestThreshold(false);
+}
+
+/*!
+ * @fn presenceRange
+ * @brief returns the suggested presence range
+ */
+byte RadarCalibration::presenceRange() {
+	return suggestRange(false);
+}
+
+/*!
+ * @fn motionThreshold
+ * @brief returns the suggested motion threshold
+ */
+byte RadarCalibration::motionThreshold() {
+	return suggestThreshold(true);
+}
+
+/*!
+ * @fn motionRange
+ * @brief returns the suggested motion range
+ */
+byte RadarCalibration::motionRange() {
+	return suggestRange(true);
+}
+
+/*!
+ * @fn suggest
+ * @brief adds the suggested thresholds and ranges to a profile, replacing any already in it,
+ * 		so profile.apply() writes them with the custom mode setters
+ * @param profile profile to add to
+ */
+void RadarCalibration::suggest(RadarProfile* profile) {
+	profile->setPresenceThreshold(presenceThreshold());
+	profile->setPresenceRange(presenceRange());
+	profile->setMotionThreshold(motionThreshold());
+	profile->setMotionRange(motionRange());
+}
@@ -0,0 +1,114 @@
+/*!
+ * @headerfile radarCalibration.h
+ * @details	threshold calibration from the background energy of an empty room. Underlying data is
+ * 			turned on for a window, the energy the module reports for the stationary and the
+ * 			moving target is added up per distance gate, and the noise floor of each gate gives
+ * 			the lowest thresholds that stay above it. A gate at the far end too noisy to threshold
+ * 			over is cut off the range instead. The suggestions go into a RadarProfile, so they
+ * 			are written with the custom mode setters in one transaction.
+ *
+ * 			The samples are read with readSamples(), so the application should not read them
+ * 			itself while calibrating. With a sample queue attached, hand the samples to add()
+ * 			instead
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarCalibration_h
+#define radarCalibration_h
+
+class RadarProfile;
+
+#define CALIBRATION_GATES			11			// gates 0 to 10, 0.5m each, the unit of the range settings
+
+#ifndef CALIBRATION_WINDOW
+#define CALIBRATION_WINDOW			30000		// default ms of empty room to collect
+#endif
+#ifndef CALIBRATION_SIGMAS
+#define CALIBRATION_SIGMAS			3			// standard deviations of noise a threshold stays above
+#endif
+#ifndef CALIBRATION_MARGIN
+#define CALIBRATION_MARGIN			5			// energy added above the noise floor
+#endif
+#ifndef CALIBRATION_CEILING
+#define CALIBRATION_CEILING			100			// highest threshold suggested before far gates are cut off the range
+#endif
+
+// calibration states
+#define CALIBRATION_IDLE			0			// not started
+#define CALIBRATION_READING			1			// waiting on the underlying data switch as it is now
+#define CALIBRATION_STARTING		2			// waiting on the underlying data on ack
+#define CALIBRATION_COLLECTING		3			// adding up the background energy
+#define CALIBRATION_STOPPING		4			// waiting on the underlying data switch going back
+#define CALIBRATION_FINISHED		5			// done, suggestions are available
+#define CALIBRATION_FAILED			6			// underlying data could not be read or turned on, nothing could be sent for TIME_TO_WAIT ms, or no report came
+
+/*!
+ * @struct		GateNoise
+ * @brief		background energy per gate of one target, an array per statistic so each is
+ * 				walked on its own
+ * @param		count		reports with the target at the gate
+ * @param		sum			sum of their energies
+ * @param		squares		sum of the squares of their energies
+ * @param		peak		highest energy reported at the gate
+ */
+
+struct GateNoise {
+	unsigned int count[CALIBRATION_GATES];
+	unsigned long sum[CALIBRATION_GATES];
+	unsigned long squares[CALIBRATION_GATES];
+	byte peak[CALIBRATION_GATES];
+};
+
+/*!
+ * @class RadarCalibration
+ * @brief suggests presence and motion thresholds and ranges from the background energy
+ *
+ */
+
+class RadarCalibration {
+	private:
+		Radar *radar;
+		byte state;
+		int handle;
+		byte underlying;
+		unsigned long started;
+		unsigned long window;
+		unsigned long progress;
+		bool failed;
+		byte max_range[2];
+		GateNoise noise[2];
+		bool submitRead();
+		bool submitUnderlying(byte onoff);
+		bool stalled();
+		bool fail();
+		void collect();
+		byte finish();
+		byte suggestRange(bool moving);
+		byte suggestThreshold(bool moving);
+	public:
+		RadarCalibration();
+		void clear();
+		void setRange(byte presence_range, byte motion_range);
+		void add(const RadarSample* sample);
+
+		bool begin(Radar *r, unsigned long ms = CALIBRATION_WINDOW);
+		bool poll();
+		bool calibrate(Radar *r, unsigned long ms = CALIBRATION_WINDOW);
+		byte getState();
+		bool ok();
+
+		unsigned int samples(bool moving, byte gate);
+		byte mean(bool moving, byte gate);
+		byte deviation(bool moving, byte gate);
+		byte peak(bool moving, byte gate);
+		byte gateThreshold(bool moving, byte gate);
+
+		byte presenceThreshold();
+		byte presenceRange();
+		byte motionThreshold();
+		byte motionRange();
+		void suggest(RadarProfile* profile);
+};
+
+#endif
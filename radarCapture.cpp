@@ -0,0 +1,62 @@
+/*
+ * CaptureWriter turns the chunks a Radar reads and writes into capture records. Times are
+ * stored as deltas so a record costs 2 or 3 bytes on top of its data.
+ *
+ */
+
+
+#include "radarCapture.h"
+
+CaptureWriter::CaptureWriter(Print* p)
+	: out(p), last(0), bytes_written(0) {
+}
+
+/*!
+ * @fn begin
+ * @brief writes the capture header and starts the capture clock
+ */
+void CaptureWriter::begin() {
+	out->write((const uint8_t*)CAPTURE_MAGIC, 3);
+	out->write((uint8_t)CAPTURE_VERSION);
+	bytes_written = CAPTURE_HEADER_SIZE;
+	last = micros();
+}
+
+/*!
+ * @fn writeVarint
+ * @brief writes a value 7 bits at a time, low bits first
+ * @param v value to write
+ */
+void CaptureWriter::writeVarint(unsigned long v) {
+	while (v >= 0x80) {
+		out->write((uint8_t)((v & 0x7F) | 0x80));
+		v = v >> 7;
+		bytes_written++;
+	}
+	out->write((uint8_t)v);
+	bytes_written++;
+}
+
+/*!
+ * @fn capture
+ * @brief writes one record
+ * @param t micros() when the bytes were read or written
+ * @param direction CAPTURE_RX or CAPTURE_TX
+ * @param bytes the bytes
+ * @param n number of bytes
+ */
+void CaptureWriter::capture(unsigned long t, byte direction, const unsigned char* bytes, unsigned int n) {
+	writeVarint(t - last);
+	writeVarint(((unsigned long)n << 1) | (direction & 0x01));
+	out->write(bytes, n);
+	bytes_written += n;
+	last = t;
+}
+
+/*!
+ * @fn written
+ * @brief returns the number of bytes written so far, header included
+ */
+unsigned long CaptureWriter::written() {
+	return bytes_written;
+}
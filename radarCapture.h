@@ -0,0 +1,58 @@
+/*!
+ * @headerfile radarCapture.h
+ * @details	raw capture of the bytes going to and from the module, with their micros() times.
+ * 			Radar hands every chunk it reads or writes to a RadarCaptureSink. CaptureWriter is
+ * 			the sink for the binary capture format, written to any Print such as an SD card file
+ * 			or a spare serial port, and read back on a host by extras/host/CaptureReplay.
+ *
+ * 			Format: the 4 byte header CAPTURE_MAGIC CAPTURE_VERSION, then one record per chunk.
+ * 			A record is a varint of the us since the previous record (or since begin()), a
+ * 			varint of the chunk length shifted left once with the direction in bit 0, and the
+ * 			bytes of the chunk. Varints are 7 bits per byte, low bits first, bit 7 set on every
+ * 			byte but the last
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarCapture_h
+#define radarCapture_h
+
+#define CAPTURE_MAGIC				"LRC"		// first 3 bytes of a capture
+#define CAPTURE_VERSION				1			// fourth byte of a capture
+#define CAPTURE_HEADER_SIZE			4
+
+// record directions
+#define CAPTURE_RX					0			// bytes read from the module
+#define CAPTURE_TX					1			// bytes written to the module
+
+/*!
+ * @class RadarCaptureSink
+ * @brief receives the raw bytes a Radar reads and writes. Called from inside updateStatus()
+ * 		and the blocking api, so it should be quick
+ */
+
+class RadarCaptureSink {
+	public:
+		virtual ~RadarCaptureSink() {}
+		virtual void capture(unsigned long t, byte direction, const unsigned char* bytes, unsigned int n) = 0;
+};
+
+/*!
+ * @class CaptureWriter
+ * @brief writes the binary capture format to a Print
+ */
+
+class CaptureWriter : public RadarCaptureSink {
+	private:
+		Print* out;
+		unsigned long last;
+		unsigned long bytes_written;
+		void writeVarint(unsigned long v);
+	public:
+		CaptureWriter(Print* p);
+		void begin();
+		void capture(unsigned long t, byte direction, const unsigned char* bytes, unsigned int n);
+		unsigned long written();
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*!
+ * @headerfile radarCommands.h
+ * @details	compile time command table for the Seeed 24ghz mmWave lite module. Every command the
+ * 			library can send is listed once here. The list generates a RadarCommand descriptor per
+ * 			command, so using a control / command pair that is not in the table fails to compile,
+ * 			constexpr lookups of data width and direction, and the fixed request frames, with
+ * 			their checksums worked out by the compiler and kept in flash.
+ * 			Included from liteRadar.h after the protocol defines.
+ *
+ * 			Define RADAR_NO_SCENARIOS to strip the built in scenario, sensitivity, time of absence
+ * 			and range commands, and the api calls that use them, when only custom modes are used.
+ */
+
+#ifndef radarCommands_h
+#define radarCommands_h
+
+// command directions
+#define DIR_NONE					0			// not a known command
+#define DIR_SET						1			// writes a value, the reply echoes it
+#define DIR_GET						2			// reads a value
+
+#define REQUEST_FRAME_SIZE			10			// frame carrying a single data byte
+#define REQUEST_DATA				0x0F		// data byte sent with get requests
+
+//	X(control, command, data width, direction)
+#define RADAR_CORE_COMMANDS(X) \
+	X(SYSTEM, RESET, 1, DIR_SET) \
+	X(WORKING_STATUS, OPEN_CUSTOM, 1, DIR_SET) \
+	X(WORKING_STATUS, EXIT_CUSTOM, 1, DIR_SET) \
+	X(CUSTOM, SET_PRESENCE_THRESHOLD, 1, DIR_SET) \
+	X(CUSTOM, GET_PRESENCE_THRESHOLD, 1, DIR_GET) \
+	X(CUSTOM, SET_PRESENCE_RANGE, 1, DIR_SET) \
+	X(CUSTOM, GET_PRESENCE_RANGE, 1, DIR_GET) \
+	X(CUSTOM, SET_MOTION_THRESHOLD, 1, DIR_SET) \
+	X(CUSTOM, GET_MOTION_THRESHOLD, 1, DIR_GET) \
+	X(CUSTOM, SET_MOTION_RANGE, 1, DIR_SET) \
+	X(CUSTOM, GET_MOTION_RANGE, 1, DIR_GET) \
+	X(CUSTOM, SET_MOTION_VALID_TIME, 4, DIR_SET) \
+	X(CUSTOM, GET_MOTION_VALID_TIME, 1, DIR_GET) \
+	X(CUSTOM, SET_STATIONARY_VALID_TIME, 4, DIR_SET) \
+	X(CUSTOM, GET_STATIONARY_VALID_TIME, 1, DIR_GET) \
+	X(CUSTOM, SET_ABSENCE_VALID_TIME, 4, DIR_SET) \
+	X(CUSTOM, GET_ABSENCE_VALID_TIME, 1, DIR_GET) \
+	X(HUMAN_STATUS, GET_PRESENCE_EVENT, 1, DIR_GET) \
+	X(HUMAN_STATUS, GET_MOTION_AMP_EVENT, 1, DIR_GET) \
+	X(HUMAN_STATUS, GET_MOTION_AMP_DATA, 1, DIR_GET) \
+	X(HUMAN_STATUS, GET_POSITIONB_EVENT, 1, DIR_GET) \
+	X(UNDERLYING, SET_UNDERLYING, 1, DIR_SET) \
+	X(UNDERLYING, GET_UNDERLYING, 1, DIR_GET)
+
+#ifndef RADAR_NO_SCENARIOS
+#define RADAR_SCENARIO_COMMANDS(X) \
+	X(WORKING_STATUS, SET_SCENARIO, 1, DIR_SET) \
+	X(WORKING_STATUS, GET_SCENARIO, 1, DIR_GET) \
+	X(WORKING_STATUS, SET_SENSITIVITY, 1, DIR_SET) \
+	X(WORKING_STATUS, GET_SENSITIVITY, 1, DIR_GET) \
+	X(HUMAN_STATUS, SET_TIME_OF_ABSENCE, 1, DIR_SET) \
+	X(HUMAN_STATUS, GET_TIME_OF_ABSENCE, 1, DIR_GET) \
+	X(WORKING_STATUS_RANGE, SET_MAX_ACTIVE_RANGE, 2, DIR_SET) \
+	X(WORKING_STATUS_RANGE, GET_MAX_ACTIVE_RANGE, 1, DIR_GET) \
+	X(WORKING_STATUS_RANGE, SET_MAX_STATIONARY_RANGE, 2, DIR_SET) \
+	X(WORKING_STATUS_RANGE, GET_MAX_STATIONARY_RANGE, 1, DIR_GET)
+#else
+#define RADAR_SCENARIO_COMMANDS(X)
+#endif
+
+#define RADAR_COMMANDS(X)	RADAR_CORE_COMMANDS(X) RADAR_SCENARIO_COMMANDS(X)
+
+/*!
+ * @struct		RadarCommand
+ * @brief		descriptor for one control / command pair. Only pairs listed in RADAR_COMMANDS
+ * 				are defined, anything else is a compile error
+ * @param		width		number of data bytes sent with the command
+ * @param		direction	DIR_SET or DIR_GET
+ */
+
+template <byte CTRL, byte CMD> struct RadarCommand;
+
+#define RADAR_COMMAND_DESCRIPTOR(ctrl, cmd, w, dir) \
+	template <> struct RadarCommand<ctrl, cmd> { \
+		static const byte width = w; \
+		static const byte direction = dir; \
+	};
+RADAR_COMMANDS(RADAR_COMMAND_DESCRIPTOR)
+
+#define RADAR_WIDTH_CASE(ctrl, cmd, w, dir)			(control == ctrl && command == cmd) ? w :
+#define RADAR_DIRECTION_CASE(ctrl, cmd, w, dir)		(control == ctrl && command == cmd) ? dir :
+
+/*!
+ * @fn commandWidth
+ * @brief number of data bytes sent with a command
+ * @returns 1, 2 or 4, 0 for a command that is not in the table
+ */
+constexpr byte commandWidth(byte control, byte command) {
+	return RADAR_COMMANDS(RADAR_WIDTH_CASE) 0;
+}
+
+/*!
+ * @fn commandDirection
+ * @brief direction of a command
+ * @returns DIR_SET, DIR_GET or DIR_NONE for a command that is not in the table
+ */
+constexpr byte commandDirection(byte control, byte command) {
+	return RADAR_COMMANDS(RADAR_DIRECTION_CASE) DIR_NONE;
+}
+
+/*!
+ * @fn requestChecksum
+ * @brief checksum of a frame carrying a single data byte
+ */
+constexpr byte requestChecksum(byte control, byte command, byte data) {
+	return (byte)(HEAD1 + HEAD2 + control + command + 0x00 + 0x01 + data);
+}
+
+/*!
+ * @struct		RadarRequest
+ * @brief		fixed request frame with a single data byte, built by the compiler and kept in
+ * 				flash. Used for every get and for the sets that always send the same byte
+ * @param		frame		the complete frame, read it with memcpy_P / pgm_read_byte
+ */
+
+template <byte CTRL, byte CMD, byte VALUE = REQUEST_DATA>
+struct RadarRequest {
+	static_assert(RadarCommand<CTRL, CMD>::width == 1, "request frames carry a single data byte");
+	static const unsigned char frame[REQUEST_FRAME_SIZE];
+};
+
+template <byte CTRL, byte CMD, byte VALUE>
+const unsigned char RadarRequest<CTRL, CMD, VALUE>::frame[REQUEST_FRAME_SIZE] PROGMEM = {
+	HEAD1, HEAD2, CTRL, CMD, 0x00, 0x01, VALUE, requestChecksum(CTRL, CMD, VALUE), END1, END2
+};
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ * The dump writers format each frame straight into a byte ring, with a table lookup for hex
+ * and a digit loop for decimal instead of sprintf. drain() writes the ring out in at most two
+ * contiguous chunks per call, the part up to the end of the ring and the part after the wrap.
+ * head and tail stay inside the ring and the fill is counted on its own, so the ring can be
+ * any size.
+ *
+ */
+
+
+#include "radarDump.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+DumpWriter::DumpWriter(Print* p, unsigned char* storage, unsigned int n, bool pace)
+	: ring(storage), size(n), head(0), tail(0), used(0), paced(pace), frames(0), dropped_frames(0), out(p) {
+}
+
+/*!
+ * @fn put
+ * @brief adds a byte to the ring, the caller has made sure it fits
+ * @param c byte to add
+ */
+void DumpWriter::put(byte c) {
+	ring[head] = c;
+	head = (head + 1 == size) ? 0 : head + 1;
+	used++;
+}
+
+/*!
+ * @fn put
+ * @brief adds bytes to the ring, the caller has made sure they fit
+ * @param bytes bytes to add
+ * @param n number of bytes
+ */
+void DumpWriter::put(const unsigned char* bytes, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) put(bytes[i]);
+}
+
+/*!
+ * @fn putHex
+ * @brief adds a byte as two hex digits
+ * @param b byte to add
+ */
+void DumpWriter::putHex(byte b) {
+	put(hex_digits[b >> 4]);
+	put(hex_digits[b & 0x0F]);
+}
+
+/*!
+ * @fn putDecimal
+ * @brief adds a number in decimal
+ * @param v number to add
+ */
+void DumpWriter::putDecimal(unsigned long v) {
+	char digits[10];
+	byte n = 0;
+	do {
+		digits[n++] = '0' + v % 10;
+		v = v / 10;
+	} while (v > 0);
+	while (n > 0) put(digits[--n]);
+}
+
+/*!
+ * @fn dump
+ * @brief formats a frame into the ring and writes out what the Print has room for. When the
+ * 		ring has no room for the frame even after that, the frame is dropped
+ * @param t millis() when the frame was received
+ * @param frame valid frame
+ */
+void DumpWriter::dump(unsigned long t, const FrameView* frame) {
+	unsigned int needed = length(frame);
+	if (size - used < needed) drain();
+	if (size - used < needed) {
+		dropped_frames++;
+		return;
+	}
+	format(t, frame);
+	frames++;
+	drain();
+}
+
+/*!
+ * @fn drain
+ * @brief writes out as much of the ring as the Print reports room for. A writer that is not
+ * 		paced writes the whole ring in one go once it is half full, for a Print that cannot
+ * 		report its room, like a file
+ */
+void DumpWriter::drain() {
+	if (used == 0) return;
+	unsigned int room = used;
+	if (paced) {
+		int available = out->availableForWrite();
+		if (available <= 0) return;
+		if ((unsigned int)available < room) room = available;
+	} else if (used < size / 2) return;
+	take(room);
+}
+
+/*!
+ * @fn take
+ * @brief writes bytes from the tail of the ring to the Print
+ * @param n number of bytes, no more than are in the ring
+ */
+void DumpWriter::take(unsigned int n) {
+	while (n > 0) {
+		unsigned int chunk = size - tail;
+		if (chunk > n) chunk = n;
+		out->write(&ring[tail], chunk);
+		tail = (tail + chunk == size) ? 0 : tail + chunk;
+		used -= chunk;
+		n -= chunk;
+	}
+}
+
+/*!
+ * @fn flush
+ * @brief writes out everything in the ring, waiting on the Print if it has to
+ */
+void DumpWriter::flush() {
+	take(used);
+	out->flush();
+}
+
+/*!
+ * @fn buffered
+ * @brief returns the number of bytes waiting in the ring
+ */
+unsigned int DumpWriter::buffered() {
+	return used;
+}
+
+/*!
+ * @fn dumped
+ * @brief returns the number of frames formatted into the ring
+ */
+unsigned long DumpWriter::dumped() {
+	return frames;
+}
+
+/*!
+ * @fn dropped
+ * @brief returns the number of frames dropped because the ring was full
+ */
+unsigned long DumpWriter::dropped() {
+	return dropped_frames;
+}
+
+HexDump::HexDump(Print* p, unsigned char* storage, unsigned int n, bool pace)
+	: DumpWriter(p, storage, n, pace) {
+}
+
+/*!
+ * @fn length
+ * @brief longest line a frame can take, time, three characters a byte and the newline
+ */
+unsigned int HexDump::length(const FrameView* frame) {
+	return 10 + 3 * frame->l + 1;
+}
+
+/*!
+ * @fn format
+ * @brief adds a frame as a line of hex
+ * @param t millis() when the frame was received
+ * @param frame valid frame
+ */
+void HexDump::format(unsigned long t, const FrameView* frame) {
+	putDecimal(t);
+	for (unsigned int i = 0; i < frame->l; i++) {
+		put(' ');
+		putHex(frame->msg[i]);
+	}
+	put('\n');
+}
+
+CsvDump::CsvDump(Print* p, unsigned char* storage, unsigned int n, bool pace)
+	: DumpWriter(p, storage, n, pace) {
+}
+
+/*!
+ * @fn begin
+ * @brief writes the header line, after anything still in the ring
+ */
+void CsvDump::begin() {
+	static const char header[] = "t,report,value,presence_energy,presence_gate,motion_energy,motion_gate,speed\n";
+	flush();
+	out->write((const uint8_t*)header, sizeof(header) - 1);
+}
+
+/*!
+ * @fn length
+ * @brief longest line a frame can take
+ */
+unsigned int CsvDump::length(const FrameView* frame) {
+	return CSV_LINE_SIZE;
+}
+
+/*!
+ * @fn format
+ * @brief adds a frame as a line of decoded fields. Reports the library does not decode are
+ * 		named by their control and command bytes in hex, with the first data byte as value
+ * @param t millis() when the frame was received
+ * @param frame valid frame
+ */
+void CsvDump::format(unsigned long t, const FrameView* frame) {
+	const unsigned char* data = frame->msg + DATA;
+	unsigned int data_length = frame->l - FRAME_OVERHEAD;
+	byte control = frame->msg[CONTROL];
+	byte command = frame->msg[COMMAND];
+	const char* report = NULL;
+	if (control == SYSTEM && command == HEARTBEAT) report = "heartbeat";
+	else if (control == HUMAN_STATUS) {
+		switch (command) {
+			case PRESENCE:				report = "presence"; break;
+			case MOTION:				report = "motion"; break;
+			case AMPLITUDE_DATA:
+			case GET_MOTION_AMP_DATA:	report = "amplitude"; break;
+			case POSITION_EVENT:
+			case GET_POSITIONB_EVENT:	report = "position"; break;
+		}
+	}
+	putDecimal(t);
+	put(',');
+	if (control == UNDERLYING && command == UNDERLYING_DATA && data_length >= UNDERLYING_DATA_LENGTH) {
+		put((const unsigned char*)"underlying,", 11);
+		for (int i = 0; i < UNDERLYING_DATA_LENGTH; i++) {
+			put(',');
+			putDecimal(data[i]);
+		}
+		put('\n');
+		return;
+	}
+	if (report != NULL) put((const unsigned char*)report, strlen(report));
+	else {
+		putHex(control);
+		putHex(command);
+	}
+	put(',');
+	if (data_length > 0) putDecimal(data[0]);
+	put((const unsigned char*)",,,,,\n", 6);
+}
+
+RawDump::RawDump(Print* p, unsigned char* storage, unsigned int n, bool pace)
+	: DumpWriter(p, storage, n, pace) {
+}
+
+/*!
+ * @fn length
+ * @brief a frame takes its own length
+ */
+unsigned int RawDump::length(const FrameView* frame) {
+	return frame->l;
+}
+
+/*!
+ * @fn format
+ * @brief adds the frame bytes
+ * @param t millis() when the frame was received, not written
+ * @param frame valid frame
+ */
+void RawDump::format(unsigned long t, const FrameView* frame) {
+	put(frame->msg, frame->l);
+}
@@ -0,0 +1,109 @@
+/*!
+ * @headerfile radarDump.h
+ * @details	frame dumps for inspecting the module output at full rate, during site tuning with
+ * 			underlying data on. Radar hands every valid frame to a RadarDumpSink. The writers
+ * 			format frames into a ring in storage the application provides and write it out in
+ * 			large chunks, only as much as the Print says it has room for, so dumping never
+ * 			blocks the parser. A frame that does not fit in the ring is dropped and counted.
+ *
+ * 			HexDump writes a line per frame, the millis() time and the frame bytes in hex.
+ * 			CsvDump writes a line per frame with the report decoded, after a header line.
+ * 			RawDump writes the frames as they came, for the host tools in extras/host
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarDump_h
+#define radarDump_h
+
+#define CSV_LINE_SIZE				64			// longest line CsvDump writes
+
+/*!
+ * @class RadarDumpSink
+ * @brief receives every valid frame a Radar reads. Called from inside updateStatus() and the
+ * 		blocking api, so it should be quick
+ */
+
+class RadarDumpSink {
+	public:
+		virtual ~RadarDumpSink() {}
+		virtual void dump(unsigned long t, const FrameView* frame) = 0;
+		virtual void drain() {}
+};
+
+/*!
+ * @class DumpWriter
+ * @brief buffered writer the dump formats are built on
+ */
+
+class DumpWriter : public RadarDumpSink {
+	private:
+		unsigned char* ring;
+		unsigned int size;
+		unsigned int head;
+		unsigned int tail;
+		unsigned int used;
+		bool paced;
+		unsigned long frames;
+		unsigned long dropped_frames;
+	protected:
+		Print* out;
+		void put(byte c);
+		void put(const unsigned char* bytes, unsigned int n);
+		void take(unsigned int n);
+		void putHex(byte b);
+		void putDecimal(unsigned long v);
+		virtual unsigned int length(const FrameView* frame) = 0;
+		virtual void format(unsigned long t, const FrameView* frame) = 0;
+	public:
+		DumpWriter(Print* p, unsigned char* storage, unsigned int n, bool pace = true);
+		void dump(unsigned long t, const FrameView* frame);
+		void drain();
+		void flush();
+		unsigned int buffered();
+		unsigned long dumped();
+		unsigned long dropped();
+};
+
+/*!
+ * @class HexDump
+ * @brief a line per frame, "t 53 59 80 01 00 01 01 2F 54 43"
+ */
+
+class HexDump : public DumpWriter {
+	protected:
+		unsigned int length(const FrameView* frame);
+		void format(unsigned long t, const FrameView* frame);
+	public:
+		HexDump(Print* p, unsigned char* storage, unsigned int n, bool pace = true);
+};
+
+/*!
+ * @class CsvDump
+ * @brief a line per frame with the report decoded, columns
+ * 		t,report,value,presence_energy,presence_gate,motion_energy,motion_gate,speed
+ */
+
+class CsvDump : public DumpWriter {
+	protected:
+		unsigned int length(const FrameView* frame);
+		void format(unsigned long t, const FrameView* frame);
+	public:
+		CsvDump(Print* p, unsigned char* storage, unsigned int n, bool pace = true);
+		void begin();
+};
+
+/*!
+ * @class RawDump
+ * @brief the frames back to back, exactly as the module sent them
+ */
+
+class RawDump : public DumpWriter {
+	protected:
+		unsigned int length(const FrameView* frame);
+		void format(unsigned long t, const FrameView* frame);
+	public:
+		RawDump(Print* p, unsigned char* storage, unsigned int n, bool pace = true);
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * RadarHistory keeps the recent presence and motion transitions of a Radar. Each entry holds
+ * the new state and the number of HISTORY_TICK_MS ticks since the entry before it, the time
+ * of the newest entry is kept in ms so absolute times can be rebuilt walking back. Times are
+ * only ever subtracted from each other, so the history keeps working when millis() wraps.
+ * Gaps longer than one entry can hold are bridged with entries that repeat the state.
+ *
+ */
+
+
+#include "radarHistory.h"
+
+RadarHistory::RadarHistory(HistoryEntry* storage, unsigned int size)
+	: entries(storage), capacity(size) {
+	clear();
+}
+
+/*!
+ * @fn clear
+ * @brief forgets every transition
+ */
+void RadarHistory::clear() {
+	head = 0;
+	count = 0;
+	first_ms = 0;
+	last_ms = 0;
+}
+
+/*!
+ * @fn age
+ * @brief returns how long before now a time was, 0 for a time after now
+ */
+static unsigned long age(unsigned long now, unsigned long t) {
+	return ((long)(now - t) > 0) ? now - t : 0;
+}
+
+/*!
+ * @fn delta
+ * @brief returns the tick delta stored in an entry
+ * @param index position in the storage array
+ */
+unsigned int RadarHistory::delta(unsigned int index) {
+	return ((unsigned int)entries[index].dt[0] << 8) | entries[index].dt[1];
+}
+
+/*!
+ * @fn push
+ * @brief appends an entry, dropping the oldest one when the storage is full
+ * @param dt ticks since the previous entry
+ * @param state state byte
+ */
+void RadarHistory::push(unsigned int dt, byte state) {
+	if (count == capacity) {
+		unsigned int oldest = (head + capacity - count) % capacity;
+		count--;
+		if (count > 0) first_ms += (unsigned long)delta((oldest + 1) % capacity) * HISTORY_TICK_MS;
+	}
+	entries[head].dt[0] = (dt >> 8) & 0xFF;
+	entries[head].dt[1] = dt & 0xFF;
+	entries[head].state = state;
+	head = (head + 1) % capacity;
+	count++;
+}
+
+/*!
+ * @fn record
+ * @brief records a transition
+ * @param t millis() of the transition
+ * @param presence new presence state
+ * @param motion new motion value
+ */
+void RadarHistory::record(unsigned long t, byte presence, byte motion) {
+	if (capacity == 0) return;
+	byte state = (presence ? HISTORY_PRESENT : 0) | ((motion & 0x03) << HISTORY_MOTION_SHIFT);
+	if (count == 0) {
+		first_ms = t;
+		last_ms = t;
+		push(0, state);
+		return;
+	}
+	unsigned long dt = age(t, last_ms) / HISTORY_TICK_MS;	// a time before the newest entry counts as 0
+	last_ms += dt * HISTORY_TICK_MS;
+	byte previous = currentState();
+	while (dt > HISTORY_MAX_DELTA) {						// bridge long gaps
+		push(HISTORY_MAX_DELTA, previous);
+		dt -= HISTORY_MAX_DELTA;
+	}
+	push(dt, state);
+	if (count == 1) first_ms = last_ms;
+}
+
+/*!
+ * @fn size
+ * @brief returns the number of entries held
+ */
+unsigned int RadarHistory::size() {
+	return count;
+}
+
+/*!
+ * @fn currentState
+ * @brief returns the state byte of the newest entry, 0 if the history is empty
+ */
+byte RadarHistory::currentState() {
+	if (count == 0) return 0;
+	return entries[(head + capacity - 1) % capacity].state;
+}
+
+/*!
+ * @fn lastTransition
+ * @brief returns the millis() time of the newest entry, to HISTORY_TICK_MS
+ */
+unsigned long RadarHistory::lastTransition() {
+	return last_ms;
+}
+
+/*!
+ * @fn timeIn
+ * @brief walks back from the newest entry adding up the time spent in matching states
+ * 		inside the window. Only the entries inside the window are visited
+ * @param mask bits of the state byte to compare
+ * @param value value the masked state must have
+ * @param window length of the window in ms
+ * @param now millis() at the end of the window
+ * @returns ms spent in matching states, time before the oldest entry is not counted
+ */
+unsigned long RadarHistory::timeIn(byte mask, byte value, unsigned long window, unsigned long now) {
+	unsigned long total = 0;
+	unsigned long segment_end = 0;							// ages in ms before now
+	unsigned long t = last_ms;
+	unsigned int index = head;
+	for (unsigned int n = 0; n < count; n++) {
+		index = (index + capacity - 1) % capacity;
+		if (segment_end >= window) break;
+		unsigned long from = age(now, t);
+		if (from > window) from = window;
+		if ((entries[index].state & mask) == value && from > segment_end) total += from - segment_end;
+		if (from > segment_end) segment_end = from;
+		t -= (unsigned long)delta(index) * HISTORY_TICK_MS;
+	}
+	return total;
+}
+
+/*!
+ * @fn occupiedTime
+ * @brief returns how long presence was reported in the last window ms
+ * @param window length of the window in ms
+ * @param now current millis()
+ */
+unsigned long RadarHistory::occupiedTime(unsigned long window, unsigned long now) {
+	return timeIn(HISTORY_PRESENT, HISTORY_PRESENT, window, now);
+}
+
+/*!
+ * @fn movingTime
+ * @brief returns how long active motion was reported in the last window ms
+ * @param window length of the window in ms
+ * @param now current millis()
+ */
+unsigned long RadarHistory::movingTime(unsigned long window, unsigned long now) {
+	return timeIn(0x03 << HISTORY_MOTION_SHIFT, 0x02 << HISTORY_MOTION_SHIFT, window, now);
+}
+
+/*!
+ * @fn transitions
+ * @brief counts the state changes recorded in the last window ms
+ * @param window length of the window in ms
+ * @param now current millis()
+ */
+unsigned int RadarHistory::transitions(unsigned long window, unsigned long now) {
+	unsigned long t = last_ms;
+	unsigned int index = head;
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < count && age(now, t) <= window; i++) {
+		index = (index + capacity - 1) % capacity;
+		unsigned int previous = (index + capacity - 1) % capacity;
+		if (i + 1 < count && entries[previous].state != entries[index].state) n++;	// skip gap fillers
+		t -= (unsigned long)delta(index) * HISTORY_TICK_MS;
+	}
+	return n;
+}
+
+/*!
+ * @fn entry
+ * @brief reads one entry back with its absolute time
+ * @param i entry number, 0 is the oldest
+ * @param t receives the millis() time of the entry, to HISTORY_TICK_MS
+ * @param state receives the state byte
+ * @returns false if there is no such entry
+ */
+bool RadarHistory::entry(unsigned int i, unsigned long* t, byte* state) {
+	if (i >= count) return false;
+	unsigned int oldest = (head + capacity - count) % capacity;
+	unsigned long ms = first_ms;
+	for (unsigned int n = 1; n <= i; n++) ms += (unsigned long)delta((oldest + n) % capacity) * HISTORY_TICK_MS;
+	*t = ms;
+	*state = entries[(oldest + i) % capacity].state;
+	return true;
+}
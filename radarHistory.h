@@ -0,0 +1,62 @@
+/*!
+ * @headerfile radarHistory.h
+ * @details	fixed size history of presence and motion transitions. Entries are delta encoded in
+ * 			3 bytes each and live in storage the application provides, so nothing is allocated.
+ * 			When the storage is full the oldest transition is dropped
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarHistory_h
+#define radarHistory_h
+
+#define HISTORY_TICK_MS				100			// time resolution of the history
+#define HISTORY_MAX_DELTA			0xFFFF		// longest gap one entry can hold, in ticks
+
+// state byte of a history entry
+#define HISTORY_PRESENT				0x01		// bit 0 is presence
+#define HISTORY_MOTION_SHIFT		1			// bits 1-2 hold the motion value
+
+/*!
+ * @struct		HistoryEntry
+ * @param		dt		ticks since the previous entry, big endian
+ * @param		state	presence in bit 0, motion value in bits 1-2
+ */
+
+struct HistoryEntry {
+	unsigned char dt[2];
+	byte state;
+};
+
+/*!
+ * @class RadarHistory
+ * @brief ring of transitions with time in state queries
+ *
+ */
+
+class RadarHistory {
+	private:
+		HistoryEntry* entries;
+		unsigned int capacity;
+		unsigned int head;
+		unsigned int count;
+		unsigned long first_ms;
+		unsigned long last_ms;
+		void push(unsigned int dt, byte state);
+		unsigned int delta(unsigned int index);
+		unsigned long timeIn(byte mask, byte value, unsigned long window, unsigned long now);
+	public:
+		RadarHistory(HistoryEntry* storage, unsigned int size);
+		void clear();
+		void record(unsigned long t, byte presence, byte motion);
+
+		unsigned int size();
+		byte currentState();
+		unsigned long lastTransition();
+		unsigned long occupiedTime(unsigned long window, unsigned long now);
+		unsigned long movingTime(unsigned long window, unsigned long now);
+		unsigned int transitions(unsigned long window, unsigned long now);
+		bool entry(unsigned int i, unsigned long* t, byte* state);
+};
+
+#endif
@@ -0,0 +1,365 @@
+/*
+ * RadarProfile batches the settings of a liteRadar module. Parameters that work outside of
+ * custom mode are sent first. Then the module is put into custom mode once, every custom
+ * parameter in the profile is sent without waiting on the previous ack, and custom mode is
+ * exited when all of the acks are in.
+ *
+ */
+
+
+#include "radarProfile.h"
+
+RadarProfile::RadarProfile(byte m)
+	: radar(NULL), mode(m), progress(0) {
+	clear();
+}
+
+/*!
+ * @fn clear
+ * @brief removes all parameters from the profile and resets the result
+ */
+void RadarProfile::clear() {
+	state = PROFILE_IDLE;
+	handle = -1;
+	requested = 0;
+	sent = 0;
+	for (int i = 0; i < PROFILE_PARAMS; i++) {
+		values[i] = 0;
+		handles[i] = -1;
+	}
+	res.opened = false;
+	res.exited = false;
+	res.succeeded = 0;
+	res.failed = 0;
+}
+
+/*!
+ * @fn set
+ * @brief records a parameter value to be sent with the profile
+ * @param param PARAM_ parameter
+ * @param value value to send
+ * @returns false if param is not a PARAM_ parameter
+ */
+bool RadarProfile::set(byte param, unsigned long value) {
+	if (param >= PROFILE_PARAMS) return false;
+	values[param] = value;
+	requested = requested | (1 << param);
+	return true;
+}
+
+/*!
+ * @fn setPresenceThreshold
+ * @brief adds the presence threshold to the profile
+ * @param threshold value between 0 and 250
+ */
+void RadarProfile::setPresenceThreshold(byte threshold) {
+	set(PROFILE_PRESENCE_THRESHOLD, threshold);
+}
+
+/*!
+ * @fn setPresenceRange
+ * @brief adds the presence range to the profile
+ * @param range values from 0 (0m) to 0A (5m) are valid
+ */
+void RadarProfile::setPresenceRange(byte range) {
+	set(PROFILE_PRESENCE_RANGE, range);
+}
+
+/*!
+ * @fn setMotionThreshold
+ * @brief adds the motion threshold to the profile
+ * @param threshold value between 0 and 250
+ */
+void RadarProfile::setMotionThreshold(byte threshold) {
+	set(PROFILE_MOTION_THRESHOLD, threshold);
+}
+
+/*!
+ * @fn setMotionRange
+ * @brief adds the motion range to the profile
+ * @param range values from 0 (0m) to 0A (5m) are valid
+ */
+void RadarProfile::setMotionRange(byte range) {
+	set(PROFILE_MOTION_RANGE, range);
+}
+
+/*!
+ * @fn setMotionValidTime
+ * @brief adds the motion valid time to the profile
+ * @param t time in ms
+ */
+void RadarProfile::setMotionValidTime(unsigned long t) {
+	set(PROFILE_MOTION_VALID_TIME, t);
+}
+
+/*!
+ * @fn setStationaryValidTime
+ * @brief adds the stationary valid time to the profile
+ * @param t time in ms
+ */
+void RadarProfile::setStationaryValidTime(unsigned long t) {
+	set(PROFILE_STATIONARY_VALID_TIME, t);
+}
+
+/*!
+ * @fn setAbsenceValidTime
+ * @brief adds the absence valid time to the profile
+ * @param t time in ms
+ */
+void RadarProfile::setAbsenceValidTime(unsigned long t) {
+	set(PROFILE_ABSENCE_VALID_TIME, t);
+}
+
+#ifndef RADAR_NO_SCENARIOS
+/*!
+ * @fn setScenario
+ * @brief adds the built in scenario to the profile
+ * @param scenario LIVING_ROOM, AREA_DETECTION, BEDROOM, or BATHROOM
+ */
+void RadarProfile::setScenario(byte scenario) {
+	set(PARAM_SCENARIO, scenario);
+}
+
+/*!
+ * @fn setSensitivity
+ * @brief adds the built in scenario sensitivity to the profile
+ * @param sensitivity value 1-3
+ */
+void RadarProfile::setSensitivity(byte sensitivity) {
+	set(PARAM_SENSITIVITY, sensitivity);
+}
+
+/*!
+ * @fn setTimeOfAbsence
+ * @brief adds the time to wait before absence is reported to the profile
+ * @param t value between 0 and 08
+ */
+void RadarProfile::setTimeOfAbsence(byte t) {
+	set(PARAM_TIME_OF_ABSENCE, t);
+}
+#endif
+
+/*!
+ * @fn setUnderlying
+ * @brief adds the underlying data switch to the profile
+ * @param onoff 0 or 1
+ */
+void RadarProfile::setUnderlying(byte onoff) {
+	set(PARAM_UNDERLYING, onoff);
+}
+
+/*!
+ * @fn begin
+ * @brief starts the transaction. Parameters that do not need custom mode are sent right
+ * 		away, the rest of the transaction is driven by poll()
+ * @param r radar to configure
+ * @returns true if the transaction was started
+ */
+bool RadarProfile::begin(Radar *r) {
+	if (state != PROFILE_IDLE && state != PROFILE_FINISHED) return false;	// already running
+	radar = r;
+	handle = -1;
+	sent = 0;
+	for (int i = 0; i < PROFILE_PARAMS; i++) handles[i] = -1;
+	progress = millis();
+	res.opened = false;
+	res.exited = false;
+	res.succeeded = 0;
+	res.failed = 0;
+	if (requested & ~PARAM_CUSTOM_MASK) {
+		state = PROFILE_BUILTIN;
+		sendParams(requested & ~PARAM_CUSTOM_MASK);
+	} else if (requested & PARAM_CUSTOM_MASK) {
+		state = PROFILE_OPENING;
+		submitMode(OPEN_CUSTOM, mode);
+	} else state = PROFILE_FINISHED;
+	return true;
+}
+
+/*!
+ * @fn submitMode
+ * @brief sends an open or exit custom mode command unless one is already in flight
+ * @param command OPEN_CUSTOM or EXIT_CUSTOM
+ * @param value data byte for the command
+ * @returns true once the command is in flight
+ */
+bool RadarProfile::submitMode(byte command, byte value) {
+	if (handle >= 0) return true;
+	unsigned char data[] = {0x00, 0x00, 0x00, value};
+	handle = radar->submitSet(WORKING_STATUS, command, data);
+	if (handle < 0) return false;
+	progress = millis();
+	return true;
+}
+
+/*!
+ * @fn sendParams
+ * @brief sends every parameter in mask not yet sent for as long as the radar has room for
+ * 		another command in flight
+ * @param mask parameters to send
+ */
+void RadarProfile::sendParams(unsigned int mask) {
+	for (int i = 0; i < PROFILE_PARAMS; i++) {
+		unsigned int bit = 1 << i;
+		if (!(mask & bit) || (sent & bit)) continue;
+		unsigned char data[4];
+		data[0] = (values[i] >> 24) & 0xFF;
+		data[1] = (values[i] >> 16) & 0xFF;
+		data[2] = (values[i] >> 8) & 0xFF;
+		data[3] = values[i] & 0xFF;
+		handles[i] = radar->submitSet(radar_params[i].control, radar_params[i].set, data);
+		if (handles[i] == SUBMIT_BUSY) return;			// table full, try again on the next poll
+		sent = sent | bit;
+		progress = millis();
+		if (handles[i] < 0) res.failed = res.failed | bit;	// can never be sent
+	}
+}
+
+/*!
+ * @fn collectParams
+ * @brief collects acks for parameters in flight, in whatever order they come back
+ * @param mask parameters the caller is waiting on
+ * @returns true once every parameter in mask has succeeded or failed
+ */
+bool RadarProfile::collectParams(unsigned int mask) {
+	for (int i = 0; i < PROFILE_PARAMS; i++) {
+		if (handles[i] < 0 || radar->commandState(handles[i]) == CMD_PENDING) continue;
+		if (radar->commandResult(handles[i], NULL)) res.succeeded = res.succeeded | (1 << i);
+		else res.failed = res.failed | (1 << i);
+		handles[i] = -1;
+		progress = millis();
+	}
+	return ((res.succeeded | res.failed) & mask) == mask;
+}
+
+/*!
+ * @fn stalled
+ * @brief a transaction is stalled when it has nothing in flight and could not send anything
+ * 		for TIME_TO_WAIT ms, such as when other callers hold every slot in the pending table.
+ * 		Commands in flight always end, by a reply or by a timeout
+ * @returns true if the transaction should give up
+ */
+bool RadarProfile::stalled() {
+	if (handle >= 0) return false;
+	for (int i = 0; i < PROFILE_PARAMS; i++) {
+		if (handles[i] >= 0) return false;
+	}
+	return millis() - progress > TIME_TO_WAIT;
+}
+
+/*!
+ * @fn giveUp
+ * @brief ends a stalled transaction. Parameters not acked yet are marked failed, and custom
+ * 		mode is exited if it was opened
+ * @returns true once the transaction has finished
+ */
+bool RadarProfile::giveUp() {
+	res.failed = res.failed | (requested & ~res.succeeded);
+	if (state == PROFILE_SETTING) {
+		state = PROFILE_EXITING;
+		progress = millis();
+		submitMode(EXIT_CUSTOM, 0x0F);
+		return false;
+	}
+	state = PROFILE_FINISHED;
+	return true;
+}
+
+/*!
+ * @fn poll
+ * @brief advances the transaction. Call it after each updateStatus() until it returns true.
+ * 		The transaction gives up once nothing was sent or acked for TIME_TO_WAIT ms
+ * @returns true once the transaction has finished
+ */
+bool RadarProfile::poll() {
+	unsigned int builtin = requested & ~PARAM_CUSTOM_MASK;
+	unsigned int custom = requested & PARAM_CUSTOM_MASK;
+	if (state != PROFILE_IDLE && state != PROFILE_FINISHED && stalled()) return giveUp();
+	switch (state) {
+		case PROFILE_BUILTIN:
+			sendParams(builtin);
+			if (!collectParams(builtin)) return false;
+			if (!custom) {
+				state = PROFILE_FINISHED;
+				return true;
+			}
+			state = PROFILE_OPENING;
+			submitMode(OPEN_CUSTOM, mode);
+			return false;
+		case PROFILE_OPENING:
+			if (!submitMode(OPEN_CUSTOM, mode)) return false;
+			if (radar->commandState(handle) == CMD_PENDING) return false;
+			res.opened = radar->commandResult(handle, NULL);
+			handle = -1;
+			progress = millis();
+			if (!res.opened) {								// nothing can be set outside custom mode
+				res.failed = res.failed | custom;
+				state = PROFILE_FINISHED;
+				return true;
+			}
+			state = PROFILE_SETTING;
+			sendParams(custom);
+			return false;
+		case PROFILE_SETTING:
+			sendParams(custom);
+			if (!collectParams(custom)) return false;
+			state = PROFILE_EXITING;
+			submitMode(EXIT_CUSTOM, 0x0F);
+			return false;
+		case PROFILE_EXITING:
+			if (!submitMode(EXIT_CUSTOM, 0x0F)) return false;
+			if (radar->commandState(handle) == CMD_PENDING) return false;
+			res.exited = radar->commandResult(handle, NULL);
+			handle = -1;
+			state = PROFILE_FINISHED;
+			return true;
+		case PROFILE_FINISHED:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*!
+ * @fn apply
+ * @brief runs the whole transaction and waits for it to finish. Presence and motion
+ * 		reports arriving meanwhile are still applied to the radar, by this call or in
+ * 		background mode by the reader task
+ * @param r radar to configure
+ * @returns true if every parameter was set and custom mode was exited
+ */
+bool RadarProfile::apply(Radar *r) {
+	if (!begin(r)) return false;
+	while (!poll()) {
+		radar->idle();
+	}
+	return ok();
+}
+
+/*!
+ * @fn getState
+ * @brief returns the state of the transaction
+ * @returns one of the PROFILE_ states
+ */
+byte RadarProfile::getState() {
+	return state;
+}
+
+/*!
+ * @fn result
+ * @brief returns the per parameter result of the last transaction
+ * @returns ProfileResult
+ */
+ProfileResult RadarProfile::result() {
+	return res;
+}
+
+/*!
+ * @fn ok
+ * @brief returns true if the last transaction set every parameter and, when it had custom
+ * 		mode parameters, exited custom mode
+ */
+bool RadarProfile::ok() {
+	if (state != PROFILE_FINISHED || res.succeeded != requested) return false;
+	return !(requested & PARAM_CUSTOM_MASK) || (res.opened && res.exited);
+}
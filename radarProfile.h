@@ -0,0 +1,97 @@
+/*!
+ * @headerfile radarProfile.h
+ * @details	batch configuration of the module parameters. All of the parameters in a profile
+ * 			are sent back to back with several commands in flight and the acks are matched as they
+ * 			come back, instead of one round trip per parameter
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarProfile_h
+#define radarProfile_h
+
+// profile parameters, also bit positions in the result masks
+#define PROFILE_PRESENCE_THRESHOLD		PARAM_PRESENCE_THRESHOLD
+#define PROFILE_PRESENCE_RANGE			PARAM_PRESENCE_RANGE
+#define PROFILE_MOTION_THRESHOLD		PARAM_MOTION_THRESHOLD
+#define PROFILE_MOTION_RANGE			PARAM_MOTION_RANGE
+#define PROFILE_MOTION_VALID_TIME		PARAM_MOTION_VALID_TIME
+#define PROFILE_STATIONARY_VALID_TIME	PARAM_STATIONARY_VALID_TIME
+#define PROFILE_ABSENCE_VALID_TIME		PARAM_ABSENCE_VALID_TIME
+#define PROFILE_PARAMS					PARAM_COUNT
+
+// profile transaction states
+#define PROFILE_IDLE					0		// not started
+#define PROFILE_OPENING					1		// waiting on the open custom mode ack
+#define PROFILE_SETTING					2		// parameters in flight
+#define PROFILE_EXITING					3		// waiting on the exit custom mode ack
+#define PROFILE_FINISHED				4		// done, result is available
+#define PROFILE_BUILTIN					5		// parameters that do not need custom mode in flight
+
+/*!
+ * @struct		ProfileResult
+ * @param		opened		custom mode was opened, false if no custom mode parameter was in the profile
+ * @param		exited		custom mode was exited and the values saved
+ * @param		succeeded	mask of parameters acked by the module, bit n is PARAM_ parameter n
+ * @param		failed		mask of parameters that were refused, timed out, or never sent because
+ * 							nothing moved for TIME_TO_WAIT ms
+ */
+
+struct ProfileResult {
+	bool opened;
+	bool exited;
+	unsigned int succeeded;
+	unsigned int failed;
+};
+
+/*!
+ * @class RadarProfile
+ * @brief collects module parameters and applies them in one transaction
+ *
+ */
+
+class RadarProfile {
+	private:
+		Radar *radar;
+		byte mode;
+		byte state;
+		int handle;
+		unsigned int requested;
+		unsigned int sent;
+		unsigned long values[PROFILE_PARAMS];
+		int handles[PROFILE_PARAMS];
+		unsigned long progress;
+		ProfileResult res;
+		bool submitMode(byte command, byte value);
+		void sendParams(unsigned int mask);
+		bool collectParams(unsigned int mask);
+		bool stalled();
+		bool giveUp();
+	public:
+		RadarProfile(byte mode);
+		void clear();
+		bool set(byte param, unsigned long value);
+
+		void setPresenceThreshold(byte threshold);
+		void setPresenceRange(byte range);
+		void setMotionThreshold(byte threshold);
+		void setMotionRange(byte range);
+		void setMotionValidTime(unsigned long t);
+		void setStationaryValidTime(unsigned long t);
+		void setAbsenceValidTime(unsigned long t);
+#ifndef RADAR_NO_SCENARIOS
+		void setScenario(byte scenario);
+		void setSensitivity(byte sensitivity);
+		void setTimeOfAbsence(byte t);
+#endif
+		void setUnderlying(byte onoff);
+
+		bool begin(Radar *r);
+		bool poll();
+		bool apply(Radar *r);
+		byte getState();
+		ProfileResult result();
+		bool ok();
+};
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * RadarPublisher keeps the published and the last reported state of every event type. A
+ * change is published once it has held for the hold time of its direction and the channel
+ * has not published within its interval, so a quiet channel publishes a change as soon as it
+ * is reported. Reports in between only move the latest state, and every transition that never
+ * gets published is counted as suppressed.
+ *
+ */
+
+
+#include "radarPublisher.h"
+
+RadarPublisher::RadarPublisher()
+	: publish_callback(NULL), publish_context(NULL) {
+	for (int i = 0; i < PUBLISH_CHANNELS; i++) {
+		channels[i].interval = PUBLISH_INTERVAL;
+		channels[i].rise = 0;
+		channels[i].fall = 0;
+	}
+	clear();
+}
+
+/*!
+ * @fn clear
+ * @brief forgets the states and the counts, every channel goes back to 0 and quiet. The
+ * 		intervals and hold times are kept
+ */
+void RadarPublisher::clear() {
+	for (int i = 0; i < PUBLISH_CHANNELS; i++) {
+		channels[i].published = 0;
+		channels[i].latest = 0;
+		channels[i].started = false;
+		channels[i].changed = 0;
+		channels[i].last_publish = 0;
+		channels[i].changes = 0;
+	}
+	suppressed_count = 0;
+	published_count = 0;
+}
+
+/*!
+ * @fn onPublish
+ * @brief registers the function the coalesced changes are published to
+ * @param callback function to call, NULL to stop publishing
+ * @param context passed back to the callback untouched
+ */
+void RadarPublisher::onPublish(RadarEventCallback callback, void* context) {
+	publish_callback = callback;
+	publish_context = context;
+}
+
+/*!
+ * @fn channel
+ * @brief finds the channel of an event type
+ * @param type EVENT_ type
+ * @returns the channel, NULL for an unknown type
+ */
+PublishChannel* RadarPublisher::channel(byte type) {
+	if (type < EVENT_PRESENCE || type >= EVENT_PRESENCE + PUBLISH_CHANNELS) return NULL;
+	return &channels[type - EVENT_PRESENCE];
+}
+
+/*!
+ * @fn setInterval
+ * @brief sets the minimum time between two publications of an event type
+ * @param type EVENT_ type
+ * @param ms interval, PUBLISH_INTERVAL by default
+ */
+void RadarPublisher::setInterval(byte type, unsigned long ms) {
+	PublishChannel* c = channel(type);
+	if (c != NULL) c->interval = ms;
+}
+
+/*!
+ * @fn setHysteresis
+ * @brief sets how long a new state has to hold before it is published. Leaving rise at 0
+ * 		keeps arrivals instant while a fall hold rides out a short absence
+ * @param type EVENT_ type
+ * @param rise ms a higher state, such as present, has to hold
+ * @param fall ms a lower state, such as absent, has to hold
+ */
+void RadarPublisher::setHysteresis(byte type, unsigned long rise, unsigned long fall) {
+	PublishChannel* c = channel(type);
+	if (c == NULL) return;
+	c->rise = rise;
+	c->fall = fall;
+}
+
+/*!
+ * @fn dueTime
+ * @brief works out when the latest state of a channel can be published
+ * @param c channel with an unpublished change
+ * @returns millis() time
+ */
+unsigned long RadarPublisher::dueTime(const PublishChannel* c) {
+	unsigned long due = c->changed + (c->latest > c->published ? c->rise : c->fall);
+	if (c->started && (long)(c->last_publish + c->interval - due) > 0) due = c->last_publish + c->interval;
+	return due;
+}
+
+/*!
+ * @fn report
+ * @brief takes an event from the radar. It is published now if it is due, otherwise it waits
+ * 		for poll() and may be replaced by later reports
+ * @param event event from the radar
+ */
+void RadarPublisher::report(const RadarEvent* event) {
+	PublishChannel* c = channel(event->type);
+	if (c == NULL || event->current == c->latest) return;
+	c->latest = event->current;
+	c->changed = event->t;
+	if (c->latest == c->published) {				// toggled back, none of it gets published
+		suppressed_count += c->changes + 1;
+		c->changes = 0;
+		return;
+	}
+	c->changes++;
+	if ((long)(event->t - dueTime(c)) >= 0) publish(event->type, event->t);
+}
+
+/*!
+ * @fn poll
+ * @brief publishes the changes that have come due. Call it from the loop, Radar does when
+ * 		the publisher is attached with setPublisher()
+ * @param now millis() time
+ */
+void RadarPublisher::poll(unsigned long now) {
+	for (int i = 0; i < PUBLISH_CHANNELS; i++) {
+		PublishChannel* c = &channels[i];
+		if (c->latest != c->published && (long)(now - dueTime(c)) >= 0) publish(EVENT_PRESENCE + i, now);
+	}
+}
+
+/*!
+ * @fn publish
+ * @brief publishes the latest state of a channel
+ * @param type EVENT_ type
+ * @param now millis() time
+ */
+void RadarPublisher::publish(byte type, unsigned long now) {
+	PublishChannel* c = channel(type);
+	RadarEvent event;
+	event.t = now;
+	event.type = type;
+	event.previous = c->published;
+	event.current = c->latest;
+	c->published = c->latest;
+	c->started = true;
+	c->last_publish = now;
+	suppressed_count += c->changes - 1;
+	c->changes = 0;
+	published_count++;
+	if (publish_callback != NULL) publish_callback(&event, publish_context);
+}
+
+/*!
+ * @fn pending
+ * @brief returns true if a change is waiting to be published
+ */
+bool RadarPublisher::pending() {
+	for (int i = 0; i < PUBLISH_CHANNELS; i++) {
+		if (channels[i].latest != channels[i].published) return true;
+	}
+	return false;
+}
+
+/*!
+ * @fn nextDue
+ * @brief returns the millis() time the next waiting change can be published, only meaningful
+ * 		when pending() is true
+ */
+unsigned long RadarPublisher::nextDue() {
+	bool found = false;
+	unsigned long due = 0;
+	for (int i = 0; i < PUBLISH_CHANNELS; i++) {
+		if (channels[i].latest == channels[i].published) continue;
+		unsigned long t = dueTime(&channels[i]);
+		if (!found || (long)(t - due) < 0) due = t;
+		found = true;
+	}
+	return due;
+}
+
+/*!
+ * @fn state
+ * @brief returns the state last published for an event type
+ * @param type EVENT_ type
+ */
+byte RadarPublisher::state(byte type) {
+	PublishChannel* c = channel(type);
+	return c != NULL ? c->published : 0;
+}
+
+/*!
+ * @fn suppressed
+ * @brief returns the number of transitions that were coalesced away and never published
+ */
+unsigned long RadarPublisher::suppressed() {
+	return suppressed_count;
+}
+
+/*!
+ * @fn published
+ * @brief returns the number of changes published
+ */
+unsigned long RadarPublisher::published() {
+	return published_count;
+}
@@ -0,0 +1,77 @@
+/*!
+ * @headerfile radarPublisher.h
+ * @details	publication layer between the radar events and whatever the states are reported
+ * 			to, a HomeKit characteristic or an MQTT topic. Every event type is a channel with a
+ * 			minimum time between publications and a hold time for each direction. Toggles that
+ * 			come faster than that are coalesced into the state they settle on, while the first
+ * 			change after a quiet spell is still published straight away
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarPublisher_h
+#define radarPublisher_h
+
+#define PUBLISH_CHANNELS			4			// one per event type, EVENT_PRESENCE to EVENT_LINK
+#define PUBLISH_INTERVAL			1000		// default ms between publications of a channel
+
+/*!
+ * @struct		PublishChannel
+ * @brief		published and last reported state of one event type
+ * @param		published		state last published
+ * @param		latest			state last reported by the radar
+ * @param		started			true once the channel has published
+ * @param		changed			millis() when latest was reported
+ * @param		last_publish	millis() of the last publication
+ * @param		interval		minimum ms between publications
+ * @param		rise			ms a higher state must hold before it is published
+ * @param		fall			ms a lower state must hold before it is published
+ * @param		changes			transitions reported since the last publication
+ */
+
+struct PublishChannel {
+	byte published;
+	byte latest;
+	bool started;
+	unsigned long changed;
+	unsigned long last_publish;
+	unsigned long interval;
+	unsigned long rise;
+	unsigned long fall;
+	unsigned int changes;
+};
+
+/*!
+ * @class RadarPublisher
+ * @brief rate limits and coalesces the radar events before they are published
+ *
+ */
+
+class RadarPublisher {
+	private:
+		PublishChannel channels[PUBLISH_CHANNELS];
+		RadarEventCallback publish_callback;
+		void* publish_context;
+		unsigned long suppressed_count;
+		unsigned long published_count;
+		PublishChannel* channel(byte type);
+		unsigned long dueTime(const PublishChannel* c);
+		void publish(byte type, unsigned long now);
+	public:
+		RadarPublisher();
+		void clear();
+		void onPublish(RadarEventCallback callback, void* context = NULL);
+		void setInterval(byte type, unsigned long ms);
+		void setHysteresis(byte type, unsigned long rise, unsigned long fall);
+
+		void report(const RadarEvent* event);
+		void poll(unsigned long now);
+		bool pending();
+		unsigned long nextDue();
+
+		byte state(byte type);
+		unsigned long suppressed();
+		unsigned long published();
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*!
+ * @headerfile radarQueue.h
+ * @details	lock free single producer single consumer queue, used to hand events and samples
+ * 			from a reader task to the rest of the application. The producer only moves head
+ * 			and the consumer only moves tail, so neither side ever waits on the other. The
+ * 			storage is provided by the application. The indexes are free running, so only a
+ * 			power of two of it is used: a static array must be sized to one, any other size
+ * 			is rounded down
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarQueue_h
+#define radarQueue_h
+
+/*!
+ * @class RadarQueue
+ * @brief fixed size queue of T. When it is full new items are dropped and counted, the
+ * 		producer never touches the consumer side
+ *
+ */
+
+template <typename T>
+class RadarQueue {
+	private:
+		T* items;
+		unsigned int mask;
+		volatile unsigned int head;
+		volatile unsigned int tail;
+		volatile unsigned long dropped;
+		/*!
+		 * @fn fit
+		 * @brief returns the largest power of two not over size, 1 for an empty size
+		 */
+		static unsigned int fit(unsigned int size) {
+			unsigned int n = 1;
+			while (n <= size / 2) n = n * 2;
+			return n;
+		}
+	public:
+		/*!
+		 * @fn RadarQueue
+		 * @brief queue over the largest power of two of items that fits in storage
+		 * @param storage array of at least one item
+		 * @param size number of items in storage
+		 */
+		RadarQueue(T* storage, unsigned int size)
+			: items(storage), mask(fit(size) - 1), head(0), tail(0), dropped(0) {
+		}
+
+		/*!
+		 * @fn RadarQueue
+		 * @brief queue over a whole array, whose size is checked when it is compiled
+		 * @param storage array of a power of two of items
+		 */
+		template <unsigned int N>
+		RadarQueue(T (&storage)[N])
+			: items(storage), mask(N - 1), head(0), tail(0), dropped(0) {
+			static_assert(N > 0 && (N & (N - 1)) == 0, "RadarQueue storage must be a power of two");
+		}
+
+		/*!
+		 * @fn push
+		 * @brief adds an item, producer side only
+		 * @returns false if the queue was full and the item was dropped
+		 */
+		bool push(const T& item) {
+			unsigned int h = head;
+			if (h - tail > mask) {
+				dropped = dropped + 1;
+				return false;
+			}
+			items[h & mask] = item;
+			RADAR_MEMORY_BARRIER();						// item is in place before head moves
+			head = h + 1;
+			return true;
+		}
+
+		/*!
+		 * @fn pop
+		 * @brief takes the oldest item, consumer side only
+		 * @returns false if the queue is empty
+		 */
+		bool pop(T* item) {
+			unsigned int t = tail;
+			if (head == t) return false;
+			RADAR_MEMORY_BARRIER();						// read the item after its head
+			*item = items[t & mask];
+			RADAR_MEMORY_BARRIER();						// item is read before its slot is freed
+			tail = t + 1;
+			return true;
+		}
+
+		/*!
+		 * @fn available
+		 * @brief returns the number of items waiting
+		 */
+		unsigned int available() {
+			return head - tail;
+		}
+
+		/*!
+		 * @fn drops
+		 * @brief returns the number of items dropped because the queue was full
+		 */
+		unsigned long drops() {
+			return dropped;
+		}
+};
+
+#endif
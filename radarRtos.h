@@ -0,0 +1,41 @@
+/*!
+ * @headerfile radarRtos.h
+ * @details	RadarLock on a FreeRTOS mutex, for background mode on the ESP32 and other FreeRTOS
+ * 			ports. The reader task calls updateStatus() in a loop and the other tasks use the
+ * 			command api, with the lock passed to setBackground(). Only compiled where the
+ * 			FreeRTOS headers are available
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarRtos_h
+#define radarRtos_h
+
+#if defined(ESP_PLATFORM) || defined(ESP32) || defined(INC_FREERTOS_H)
+
+#if defined(ESP_PLATFORM) || defined(ESP32)
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#else
+#include "semphr.h"
+#endif
+
+/*!
+ * @class FreeRTOSLock
+ * @brief RadarLock on a FreeRTOS mutex, created statically so it never fails to allocate
+ */
+
+class FreeRTOSLock : public RadarLock {
+	private:
+		StaticSemaphore_t storage;
+		SemaphoreHandle_t mutex;
+	public:
+		FreeRTOSLock() { mutex = xSemaphoreCreateMutexStatic(&storage); }
+		~FreeRTOSLock() { vSemaphoreDelete(mutex); }
+		void lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+		void unlock() { xSemaphoreGive(mutex); }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * RadarZones walks its zones for every underlying data report, so the cost is a couple of
+ * compares per zone per report. A zone is entered on the first report with a target in its
+ * band and left once the hold time passes without one, which rides out the reports where the
+ * module briefly loses the target. A visit is timed from the first to the last report that
+ * saw it.
+ *
+ */
+
+
+#include "radarZones.h"
+
+RadarZones::RadarZones(RadarZone* storage, byte n)
+	: zones(storage), capacity(n), count(0), threshold(ZONE_THRESHOLD), hold(ZONE_HOLD),
+	  direction(POSITION_NONE) {
+}
+
+/*!
+ * @fn addZone
+ * @brief declares a zone. Zones may overlap, a target in both is in both
+ * @param near first gate of the zone, 0.5m per gate
+ * @param far last gate of the zone
+ * @param callback function called when the zone becomes occupied or vacant, may be NULL
+ * @param context passed back to the callback untouched
+ * @returns index of the zone, -1 if the storage is full
+ */
+int RadarZones::addZone(byte near, byte far, RadarZoneCallback callback, void* context) {
+	if (count >= capacity) return -1;
+	RadarZone* z = &zones[count];
+	z->near = (near < far) ? near : far;
+	z->far = (near < far) ? far : near;
+	z->occupied = false;
+	z->entered = 0;
+	z->last_seen = 0;
+	z->dwell = 0;
+	z->visits = 0;
+	z->callback = callback;
+	z->context = context;
+	return count++;
+}
+
+/*!
+ * @fn setThreshold
+ * @brief sets the energy a target needs before it places anything in a zone
+ * @param energy value between 0 and 250, ZONE_THRESHOLD by default
+ */
+void RadarZones::setThreshold(byte energy) {
+	threshold = energy;
+}
+
+/*!
+ * @fn setHold
+ * @brief sets how long a zone stays occupied after the last report that saw a target in it
+ * @param ms hold time, ZONE_HOLD by default
+ */
+void RadarZones::setHold(unsigned long ms) {
+	hold = ms;
+}
+
+/*!
+ * @fn clear
+ * @brief marks every zone vacant and forgets the dwell times and visits, without calling back.
+ * 		The zones themselves are kept
+ */
+void RadarZones::clear() {
+	for (byte i = 0; i < count; i++) {
+		zones[i].occupied = false;
+		zones[i].dwell = 0;
+		zones[i].visits = 0;
+	}
+	direction = POSITION_NONE;
+}
+
+/*!
+ * @fn enter
+ * @brief starts a visit
+ * @param zone index of the zone
+ * @param t millis() of the report
+ */
+void RadarZones::enter(byte zone, unsigned long t) {
+	RadarZone* z = &zones[zone];
+	z->occupied = true;
+	z->entered = t;
+	z->visits++;
+	if (z->callback != NULL) z->callback(zone, true, 0, z->context);
+}
+
+/*!
+ * @fn leave
+ * @brief ends a visit and adds it to the dwell time
+ * @param zone index of the zone
+ */
+void RadarZones::leave(byte zone) {
+	RadarZone* z = &zones[zone];
+	unsigned long visit = z->last_seen - z->entered;
+	z->occupied = false;
+	z->dwell += visit;
+	if (z->callback != NULL) z->callback(zone, false, visit, z->context);
+}
+
+/*!
+ * @fn add
+ * @brief takes a decoded report. Underlying data places the targets in zones, a position
+ * 		report sets the direction of travel. Other reports are ignored
+ * @param sample report decoded by the radar
+ */
+void RadarZones::add(const RadarSample* sample) {
+	if (sample->type == SAMPLE_POSITION) {
+		direction = sample->position;
+		return;
+	}
+	if (sample->type != SAMPLE_UNDERLYING) return;
+	bool stationary = sample->presence_energy >= threshold;
+	bool moving = sample->motion_energy >= threshold;
+	for (byte i = 0; i < count; i++) {
+		RadarZone* z = &zones[i];
+		bool in = (stationary && sample->presence_gate >= z->near && sample->presence_gate <= z->far) ||
+			(moving && sample->motion_gate >= z->near && sample->motion_gate <= z->far);
+		if (!in) continue;
+		z->last_seen = sample->t;
+		if (!z->occupied) enter(i, sample->t);
+	}
+}
+
+/*!
+ * @fn update
+ * @brief vacates the zones no target has been in for the hold time. Radar calls it from
+ * 		updateStatus() when the zones are attached with setZones()
+ * @param now millis() time
+ */
+void RadarZones::update(unsigned long now) {
+	for (byte i = 0; i < count; i++) {
+		if (zones[i].occupied && now - zones[i].last_seen > hold) leave(i);
+	}
+}
+
+/*!
+ * @fn vacate
+ * @brief vacates every zone at once, when the module reports absence
+ */
+void RadarZones::vacate() {
+	for (byte i = 0; i < count; i++) {
+		if (zones[i].occupied) leave(i);
+	}
+	direction = POSITION_NONE;
+}
+
+/*!
+ * @fn size
+ * @brief returns the number of zones declared
+ */
+byte RadarZones::size() {
+	return count;
+}
+
+/*!
+ * @fn occupied
+ * @brief returns true while a target is in the zone
+ * @param zone index of the zone
+ */
+bool RadarZones::occupied(byte zone) {
+	return zone < count && zones[zone].occupied;
+}
+
+/*!
+ * @fn dwell
+ * @brief returns the time spent in the zone, the current visit included
+ * @param zone index of the zone
+ * @param now millis() time
+ * @returns time in ms
+ */
+unsigned long RadarZones::dwell(byte zone, unsigned long now) {
+	if (zone >= count) return 0;
+	const RadarZone* z = &zones[zone];
+	return z->dwell + (z->occupied ? now - z->entered : 0);
+}
+
+/*!
+ * @fn visits
+ * @brief returns the number of visits to the zone
+ * @param zone index of the zone
+ */
+unsigned long RadarZones::visits(byte zone) {
+	return zone < count ? zones[zone].visits : 0;
+}
+
+/*!
+ * @fn position
+ * @brief returns the last position report, POSITION_NONE, POSITION_APPROACHING or
+ * 		POSITION_LEAVING
+ */
+byte RadarZones::position() {
+	return direction;
+}
@@ -0,0 +1,96 @@
+/*!
+ * @headerfile radarZones.h
+ * @details	zone occupancy on the MCU. The application declares zones as bands of distance
+ * 			gates, 0.5m each, in storage it provides, such as a desk at gates 2-3 and a doorway
+ * 			at gates 6-8. Every underlying data report places the stationary and the moving
+ * 			target in the zones their gates fall in, and a zone is vacated when neither has been
+ * 			in it for the hold time or the module reports absence. Occupancy changes go to a
+ * 			callback set per zone, and the time spent in each zone is added up.
+ *
+ * 			The position reports only say whether the target is approaching or leaving, so the
+ * 			distance comes from the underlying data, which has to be turned on with
+ * 			setUnderlying(0x01). The last position report is kept as the direction of travel
+ */
+
+#include "liteRadar.h"
+
+#ifndef radarZones_h
+#define radarZones_h
+
+#define ZONE_THRESHOLD				10			// default energy a target needs to count
+#define ZONE_HOLD					1500		// default ms a zone stays occupied after the target was last in it
+
+// position report values
+#define POSITION_NONE				0			// no approach or departure
+#define POSITION_APPROACHING		1			// target moving toward the module
+#define POSITION_LEAVING			2			// target moving away from the module
+
+/*!
+ * @typedef		RadarZoneCallback
+ * @brief		function called when a zone becomes occupied or vacant. visit is the length of
+ * 				the visit that just ended in ms, 0 when the zone becomes occupied
+ */
+
+typedef void (*RadarZoneCallback)(byte zone, bool occupied, unsigned long visit, void* context);
+
+/*!
+ * @struct		RadarZone
+ * @brief		one zone and its occupancy
+ * @param		near		first gate of the zone
+ * @param		far			last gate of the zone
+ * @param		occupied	true while a target is in the zone
+ * @param		entered		millis() when the current visit started
+ * @param		last_seen	millis() of the last report with a target in the zone
+ * @param		dwell		ms spent in the zone over all finished visits
+ * @param		visits		number of visits started
+ * @param		callback	function called when occupancy changes, may be NULL
+ * @param		context		passed back to the callback untouched
+ */
+
+struct RadarZone {
+	byte near;
+	byte far;
+	bool occupied;
+	unsigned long entered;
+	unsigned long last_seen;
+	unsigned long dwell;
+	unsigned long visits;
+	RadarZoneCallback callback;
+	void* context;
+};
+
+/*!
+ * @class RadarZones
+ * @brief keeps the occupancy and dwell time of each zone up to date from the decoded reports
+ *
+ */
+
+class RadarZones {
+	private:
+		RadarZone* zones;
+		byte capacity;
+		byte count;
+		byte threshold;
+		unsigned long hold;
+		byte direction;
+		void enter(byte zone, unsigned long t);
+		void leave(byte zone);
+	public:
+		RadarZones(RadarZone* storage, byte n);
+		int addZone(byte near, byte far, RadarZoneCallback callback = NULL, void* context = NULL);
+		void setThreshold(byte energy);
+		void setHold(unsigned long ms);
+		void clear();
+
+		void add(const RadarSample* sample);
+		void update(unsigned long now);
+		void vacate();
+
+		byte size();
+		bool occupied(byte zone);
+		unsigned long dwell(byte zone, unsigned long now);
+		unsigned long visits(byte zone);
+		byte position();
+};
+
+#endif